@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2005-2010 Tony Bai <bigwhite.cn@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * the allocation checks, linked with liblcut_alloc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lcut.h"
+
+static char* join_into(char *buf, size_t len, const char *a, const char *b) {
+    snprintf(buf, len, "%s/%s", a, b);
+    return buf;
+}
+
+static char* join_dup(const char *a, const char *b) {
+    size_t  len = strlen(a) + strlen(b) + 2;
+    char    *p  = malloc(len);
+
+    if (p != NULL) {
+        join_into(p, len, a, b);
+    }
+    return p;
+}
+
+void tc_join_into_allocates_nothing(lcut_tc_t *tc, void *data) {
+    char    buf[64];
+
+    LCUT_STR_EQUAL(tc, "suite/case", join_into(buf, sizeof(buf), "suite", "case"));
+    LCUT_ALLOCS_LE(tc, 0);
+}
+
+void tc_join_dup_frees_its_block(lcut_tc_t *tc, void *data) {
+    char    *p  = join_dup("suite", "case");
+
+    LCUT_STR_EQUAL(tc, "suite/case", p);
+    free(p);
+    LCUT_ALLOCS_LE(tc, 1);
+    LCUT_NO_LEAKS(tc);
+
+    /* Failed assert below:
+     * p = join_dup("suite", "case");
+     * LCUT_NO_LEAKS(tc);
+     */
+}
+
+int main(int argc, char **argv) {
+    lcut_ts_t   *suite = NULL;
+    LCUT_TEST_BEGIN("a heap allocation test", NULL, NULL);
+    LCUT_TEST_ARGS(argc, argv);
+
+    LCUT_TS_INIT(suite, "a heap allocation test suite", NULL, NULL);
+    LCUT_TC_ADD(suite, "join into a buffer allocates nothing", tc_join_into_allocates_nothing, NULL, NULL, NULL);
+    LCUT_TC_ADD(suite, "join dup frees its block", tc_join_dup_frees_its_block, NULL, NULL, NULL);
+    LCUT_TS_ADD(suite);
+
+    LCUT_TEST_RUN();
+    LCUT_TEST_REPORT();
+    LCUT_TEST_END();
+
+    LCUT_TEST_RESULT();
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2005-2010 Tony Bai <bigwhite.cn@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lcut.h"
+
+extern int add(int a, int b);
+extern int subtract(int a, int b);
+extern int multiply(int a, int b);
+extern int divide(int a, int b);
+
+static int operand;
+
+static void setup_operand(void) {
+    operand = 8;
+}
+
+LCUT_SUITE(calculator, setup_operand, NULL);
+
+LCUT_CASE(calculator, add) {
+    LCUT_INT_EQUAL(tc, 10, add(2, operand));
+    LCUT_INT_EQUAL(tc, -6, add(2, -operand));
+}
+
+LCUT_CASE(calculator, subtract) {
+    LCUT_INT_EQUAL(tc, 6, subtract(operand, 2));
+    LCUT_INT_EQUAL(tc, 10, subtract(2, -operand));
+}
+
+LCUT_CASE(calculator, multiply) {
+    LCUT_INT_EQUAL(tc, 16, multiply(operand, 2));
+}
+
+LCUT_CASE(calculator, divide) {
+    LCUT_INT_EQUAL(tc, 4, divide(operand, 2));
+}
+
+LCUT_CASE(identity, add_zero) {
+    LCUT_INT_EQUAL(tc, 2, add(2, 0));
+}
+
+LCUT_CASE(identity, multiply_one) {
+    LCUT_INT_EQUAL(tc, 2, multiply(2, 1));
+}
+
+LCUT_MAIN()
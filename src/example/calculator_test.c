@@ -43,21 +43,124 @@ void tc_multiply(lcut_tc_t *tc, void *data) {
     LCUT_INT_EQUAL(tc, 0, multiply(0, 2));
 }
 
+/*
+ * checked with --perf only, and on a cpu counting instructions
+ */
+void tc_multiply_perf(lcut_tc_t *tc, void *data) {
+    LCUT_INT_EQUAL(tc, 16, multiply(8, 2));
+    LCUT_INSTRUCTIONS_LE(tc, 10000);
+}
+
 void tc_divide(lcut_tc_t *tc, void *data) {
     LCUT_INT_EQUAL(tc, 4, divide(8, 2));
     LCUT_INT_EQUAL(tc, 0, divide(0, 8));
     LCUT_INT_EQUAL(tc, 1, divide(2, 2));
 }
 
-int main() {
+void tc_ratio(lcut_tc_t *tc, void *data) {
+    float   e[256];
+    float   a[256];
+    int     i;
+
+    for (i = 0; i < 256; i++) {
+        e[i] = i / 3.0f;
+        a[i] = i * (1.0f / 3.0f);
+    }
+
+    LCUT_DOUBLE_NEAR(tc, 8 / 3.0, divide(8, 3) + 2 / 3.0, 1e-12);
+    LCUT_FLOAT_ARRAY_ULP(tc, e, a, 256, 1);
+    LCUT_FLOAT_ARRAY_NEAR(tc, e, a, 256, 0.0, 1e-6);
+    /* Failed assert below, reports the worst element and its error:
+     * LCUT_FLOAT_ARRAY_NEAR(tc, e, a, 256, 0.0, 0.0);
+     */
+}
+
+typedef struct calc_row_t {
+    int     a;
+    int     b;
+    int     expected;
+} calc_row_t;
+
+static const calc_row_t _add_rows[] = {
+    {2, 8, 10},
+    {2, -8, -6},
+    {2, -2, 0},
+    {0, 0, 0},
+    {-3, -4, -7}
+};
+
+void tc_add_row(lcut_tc_t *tc, void *data) {
+    const calc_row_t    *row = data;
+
+    LCUT_INT_EQUAL(tc, row->expected, add(row->a, row->b));
+}
+
+/*
+ * makes the rows of the divide case, index * 7 / 7 gives the index back
+ */
+void gen_divide_row(void *data, int index, void *row) {
+    calc_row_t  *r = row;
+
+    r->a        = index * 7;
+    r->b        = 7;
+    r->expected = index;
+}
+
+void tc_divide_row(lcut_tc_t *tc, void *data) {
+    const calc_row_t    *row = data;
+
+    LCUT_INT_EQUAL(tc, row->expected, divide(row->a, row->b));
+}
+
+/*
+ * a property, holds for any a and any b but 0
+ */
+void prop_divide(lcut_tc_t *tc, void *data) {
+    int a = (int)lcut_gen_range(tc, -100000, 100000);
+    int b = (int)lcut_gen_range(tc, 1, 1000);
+
+    LCUT_INT_EQUAL(tc, a, add(multiply(divide(a, b), b), a % b));
+    LCUT_INT_EQUAL(tc, divide(-a, b), -divide(a, b));
+}
+
+void bench_add(lcut_tc_t *tc, void *data) {
+    int i = 0;
+
+    LCUT_BENCH_LOOP(tc) {
+        LCUT_BENCH_SINK(add(i++, 8));
+    }
+}
+
+void bench_multiply(lcut_tc_t *tc, void *data) {
+    int i = 0;
+
+    LCUT_BENCH_LOOP(tc) {
+        LCUT_BENCH_SINK(multiply(i++, 8));
+    }
+}
+
+int main(int argc, char **argv) {
     lcut_ts_t   *suite = NULL;
     LCUT_TEST_BEGIN("a simple calculator test", NULL, NULL);
+    LCUT_TEST_ARGS(argc, argv);
 
     LCUT_TS_INIT(suite, "a simple calculator unit test suite", NULL, NULL);
     LCUT_TC_ADD(suite, "add test case", tc_add, NULL, NULL, NULL);
     LCUT_TC_ADD(suite, "subtract test case", tc_subtract, NULL, NULL, NULL);
     LCUT_TC_ADD(suite, "multiply test case", tc_multiply, NULL, NULL, NULL);
+    LCUT_TC_ADD(suite, "multiply perf case", tc_multiply_perf, NULL, NULL, NULL);
     LCUT_TC_ADD(suite, "divide test case", tc_divide, NULL, NULL, NULL);
+    LCUT_TC_ADD(suite, "ratio test case", tc_ratio, NULL, NULL, NULL);
+    LCUT_TC_ADD_ROWS(suite, "add table test case", tc_add_row, _add_rows,
+                     sizeof(_add_rows) / sizeof(_add_rows[0]), NULL, NULL);
+    LCUT_TC_ADD_GEN(suite, "divide rows test case", tc_divide_row, gen_divide_row, NULL,
+                    sizeof(calc_row_t), 4, NULL, NULL);
+    LCUT_PROP_ADD(suite, "divide property case", prop_divide, NULL, 2000, NULL, NULL);
+    LCUT_TS_ADD(suite);
+
+    LCUT_TS_INIT(suite, "a simple calculator benchmark suite", NULL, NULL);
+    LCUT_BENCH_ADD(suite, "add benchmark", bench_add, NULL, NULL, NULL);
+    LCUT_BENCH_ADD(suite, "multiply benchmark", bench_multiply, NULL, NULL, NULL);
     LCUT_TS_ADD(suite);
 
     LCUT_TEST_RUN();
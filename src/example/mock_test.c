@@ -91,10 +91,11 @@ void tc_test_bar_invoke_foo_multi_times_using_always_return_mock(lcut_tc_t *tc,
 
 }
 
-int main() {
+int main(int argc, char **argv) {
     lcut_ts_t   *suite = NULL;
 
     LCUT_TEST_BEGIN("lcut mock interface test", NULL, NULL);
+    LCUT_TEST_ARGS(argc, argv);
 
     LCUT_TS_INIT(suite, "mock unit test suite", NULL, NULL);
     LCUT_TC_ADD(suite, "tc_test_bar_invoke_foo_multi_times_using_always_return_mock!",
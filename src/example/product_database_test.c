@@ -57,10 +57,11 @@ void tc_get_total_count_of_employee_fetch_rowcount_failed(lcut_tc_t *tc, void *d
     LCUT_INT_EQUAL(tc, -1, get_total_count_of_employee());
 }
 
-int main() {
+int main(int argc, char **argv) {
     lcut_ts_t   *suite = NULL;
 
     LCUT_TEST_BEGIN("product database test", NULL, NULL);
+    LCUT_TEST_ARGS(argc, argv);
 
     LCUT_TS_INIT(suite, "product database unit test - normal result suite", NULL, NULL);
     LCUT_TC_ADD(suite, "get total count of employees ok!", tc_get_total_count_of_employee_ok, NULL, NULL, NULL);
@@ -23,9 +23,10 @@ void tc_null_test(lcut_tc_t *tc, void *data) {
 
 }
 
-int main() {
+int main(int argc, char **argv) {
     lcut_ts_t   *suite = NULL;
     LCUT_TEST_BEGIN("a null test", NULL, NULL);
+    LCUT_TEST_ARGS(argc, argv);
 
     LCUT_TS_INIT(suite, "a null test suite", NULL, NULL);
     LCUT_TC_ADD(suite, "null test", tc_null_test, NULL, NULL, NULL);
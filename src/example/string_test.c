@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <string.h>
 #include "lcut.h"
 
 void tc_str_equal(lcut_tc_t *tc, void *data) {
@@ -38,9 +39,54 @@ void tc_str_nequal(lcut_tc_t *tc, void *data) {
      */
 }
 
-int main() {
+static char src[256];
+static char dst[256];
+
+static char* copy_bytes(char *d, const char *s) {
+    char *p = d;
+
+    while ((*p++ = *s++) != '\0') {
+        ;
+    }
+    return d;
+}
+
+static char* copy_memcpy(char *d, const char *s) {
+    return memcpy(d, s, strlen(s) + 1);
+}
+
+void fill_src(void) {
+    memset(src, 'x', sizeof(src) - 1);
+}
+
+void tc_copy(lcut_tc_t *tc, void *data) {
+    short   a[4] = {1, 2, 3, 4};
+    short   b[4];
+
+    LCUT_MEM_EQUAL(tc, src, copy_bytes(dst, src), sizeof(src));
+    LCUT_MEM_EQUAL(tc, src, copy_memcpy(dst, src), sizeof(src));
+    LCUT_ARRAY_EQUAL(tc, a, (short*)memcpy(b, a, sizeof(a)), 4);
+    /* Failed assert below, reports the first byte which differs:
+     * LCUT_MEM_EQUAL(tc, src, "xxxy", 4);
+     */
+}
+
+void bench_copy_bytes(lcut_tc_t *tc, void *data) {
+    LCUT_BENCH_LOOP(tc) {
+        LCUT_BENCH_SINK(copy_bytes(dst, src));
+    }
+}
+
+void bench_copy_memcpy(lcut_tc_t *tc, void *data) {
+    LCUT_BENCH_LOOP(tc) {
+        LCUT_BENCH_SINK(copy_memcpy(dst, src));
+    }
+}
+
+int main(int argc, char **argv) {
     lcut_ts_t   *suite = NULL;
     LCUT_TEST_BEGIN("a string equal and unequal test", NULL, NULL);
+    LCUT_TEST_ARGS(argc, argv);
 
     LCUT_TS_INIT(suite, "a string equal test suite", NULL, NULL);
     LCUT_TC_ADD(suite, "string equal test", tc_str_equal, NULL, NULL, NULL);
@@ -50,6 +96,12 @@ int main() {
     LCUT_TC_ADD(suite, "string nequal test", tc_str_nequal, NULL, NULL, NULL);
     LCUT_TS_ADD(suite);
 
+    LCUT_TS_INIT(suite, "a string copy benchmark suite", fill_src, NULL);
+    LCUT_TC_ADD(suite, "copy test", tc_copy, NULL, NULL, NULL);
+    LCUT_BENCH_AB_ADD(suite, "byte loop vs memcpy copy", bench_copy_bytes, bench_copy_memcpy,
+                      NULL, NULL, NULL, -1);
+    LCUT_TS_ADD(suite);
+
     LCUT_TEST_RUN();
     LCUT_TEST_REPORT();
     LCUT_TEST_END();
@@ -14,16 +14,369 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE /* fork, pipe and poll are hidden by -std=c99 */
+
 #include <string.h>
+#include <math.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <time.h>
+#include <fnmatch.h>
+#include <stddef.h>
+#include <pthread.h>
 #include "lcut.h"
 
-static lcut_symbol_head_t _symbol_list;
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define LCUT_X86_SIMD 1
+#endif
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#define LCUT_PERF_EVENTS 1
+#endif
+
+#if defined(__GLIBC__)
+#include <stdio_ext.h>
+#endif
+
+#define LCUT_MAX_DETAIL_LEN 1024  /* the lines under a failure carried back by a worker */
+#define LCUT_WRITER_BUF (1 << 20) /* the buffer of a writer on a file */
+#define LCUT_WRITER_MEM 4096      /* the first buffer of a writer in memory */
+
+#define ATOMIC_INC(p) __sync_add_and_fetch((p), 1)
+#define ATOMIC_DEC(p) __sync_sub_and_fetch((p), 1)
+#define ATOMIC_ADD(p, v) __sync_add_and_fetch((p), (v))
+#define ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/*
+ * the flattened view of the suite and case rings which
+ * the runners walk, built at the beginning of lcut_test_run
+ */
+typedef struct lcut_plan_ts_t {
+    lcut_ts_t                   *ts;
+    int                         first;      /* index of the first case of the suite */
+    int                         count;      /* the count of cases in the suite */
+    int                         pending;    /* thread runner: cases not finished yet */
+    int                         entered;    /* thread runner: 1 when setup has been run */
+    pthread_mutex_t             lock;       /* thread runner: guards the setup */
+} lcut_plan_ts_t;
+
+typedef struct lcut_plan_tc_t {
+    lcut_tc_t                   *tc;        /* a row: its parameterized case, or its own while it runs */
+    int                         suite;      /* index of the owner suite */
+    int                         done;       /* 1: the result is available */
+    unsigned long long          key;        /* identifies the case across runs */
+    long long                   est_ns;     /* the duration of the last run, -1: unknown */
+    long long                   elapsed_ns; /* the duration of this run */
+    int                         timeout_ms; /* 0: no timeout */
+    volatile int                phase;      /* where the case is: CASE_BEFORE, CASE_FUNC... */
+    int                         selected;   /* 0: dropped by plan_compact */
+    int                         skipped;    /* 1: not run, the run stopped before */
+    unsigned int                history;    /* outcomes of the last runs, bit 0 the latest, 1: failed */
+    unsigned int                runs;       /* the count of runs in the history */
+    int                         flaky;      /* 1: flips between pass and fail across runs */
+    lcut_bench_t                *base;      /* the baseline of a benchmark case, NULL: none */
+    int                         started;    /* 1: reported as started */
+    int                         row;        /* the row of a parameterized case, -1: a plain case */
+    int                         failed;     /* 1: failed, kept when the case of a row is dropped */
+} lcut_plan_tc_t;
+
+enum {
+    CASE_BEFORE = 1,
+    CASE_FUNC   = 2,
+    CASE_AFTER  = 3
+};
+
+typedef struct lcut_plan_t {
+    lcut_plan_ts_t              *suites;
+    int                         nsuites;
+    lcut_plan_tc_t              *cases;
+    int                         ncases;
+    int                         next_suite; /* the first suite not reported as started */
+    int                         next_case;  /* the first case whose result is not reported */
+    int                         open_suite; /* 1 + the suite started and not ended, 0: none */
+    int                         reported;   /* the count of cases reported */
+    lcut_reporter_t             *reporters; /* the listeners of the run */
+    lcut_writer_t               *notes;     /* the console's stdout, NULL: not printed */
+    int                         nestimated; /* the count of cases with a known duration */
+    int                         slow_ms;    /* the cases running longer are slow, 0: none */
+    int                         dropped_suites; /* suites dropped by plan_compact */
+    int                         dropped_cases;  /* cases dropped by plan_compact */
+    int                         max_failures;   /* stop after so many failed cases, 0: never */
+    volatile int                failures;       /* the count of failed cases */
+    volatile int                skipped;        /* the count of cases skipped after the stop */
+    double                      max_regression; /* the benchmark slowdown failing a case, in % */
+    lcut_perf_t                 *perfs;         /* the perf events of the cases, with --perf only */
+    FILE                        *results;       /* the results file, written as the cases are reported */
+} lcut_plan_t;
+
+/*
+ * a benchmark in the baseline file
+ */
+typedef struct lcut_baseline_t {
+    unsigned long long          key;
+    char                        *suite;
+    char                        *name;
+    lcut_bench_t                bench;
+    int                         ran;        /* 1: the benchmark ran again in this run */
+} lcut_baseline_t;
+
+typedef struct lcut_baselines_t {
+    lcut_baseline_t             *items;
+    int                         count;
+} lcut_baselines_t;
+
+/*
+ * the case durations remembered in the timings file,
+ * an open addressing hash table keyed by lcut_plan_tc_t::key
+ */
+typedef struct lcut_timing_t {
+    unsigned long long          key;        /* 0: empty slot */
+    long long                   ns;
+    const char                  *ts_desc;   /* set when the case is in this run */
+    const char                  *tc_desc;
+    int                         row;        /* the row of a parameterized case, -1: a plain case */
+} lcut_timing_t;
+
+typedef struct lcut_timings_t {
+    lcut_timing_t               *slots;
+    size_t                      cap;        /* power of 2 */
+    size_t                      count;
+} lcut_timings_t;
+
+/*
+ * the history file is mapped into memory, a header followed by an
+ * open addressing hash table of the cases keyed by lcut_plan_tc_t::key.
+ * it is mapped under an flock twice a run, once to load and once to
+ * save, so the runs sharing it do not lose the records of each other
+ */
+#define LCUT_HISTORY_MAGIC  "lcut-hi1"
+#define LCUT_HISTORY_WINDOW 16  /* the runs looked at for flaky cases */
+#define LCUT_HISTORY_FLIPS  3   /* the flips in the window making a case flaky */
+
+typedef struct lcut_history_rec_t {
+    unsigned long long          key;        /* 0: empty slot */
+    long long                   ns;         /* the duration of the last run */
+    unsigned int                runs;       /* the count of runs recorded */
+    unsigned int                outcomes;   /* bit 0 the latest run, 1: failed */
+} lcut_history_rec_t;
+
+typedef struct lcut_history_hdr_t {
+    char                        magic[8];
+    unsigned int                cap;        /* power of 2 */
+    unsigned int                count;
+} lcut_history_hdr_t;
+
+typedef struct lcut_history_t {
+    int                         fd;
+    size_t                      size;
+    lcut_history_hdr_t          *hdr;
+    lcut_history_rec_t          *recs;
+} lcut_history_t;
+
+/*
+ * hands the cases over to the workers. without timings the cases go
+ * in ring order, otherwise every worker owns a queue of cases sorted
+ * longest-first, and steals the shortest ones of the most loaded queue
+ * when its own queue runs dry.
+ */
+typedef struct lcut_queue_t {
+    pthread_mutex_t             lock;
+    int                         head;       /* the next case to pop, the longest */
+    int                         tail;       /* one past the last case, the shortest */
+    long long                   load;       /* the estimated ns left in the queue */
+} lcut_queue_t;
+
+typedef struct lcut_sched_t {
+    lcut_plan_t                 *plan;
+    int                         next;       /* ring order: the next case to hand over */
+    int                         left;       /* the count of cases not handed over */
+    int                         nqueues;    /* 0: ring order */
+    lcut_queue_t                *queues;
+    int                         *items;     /* case indexes of all queues, back to back */
+} lcut_sched_t;
+
+/*
+ * what a worker process sends back to the parent for each case,
+ * small enough to be written into a pipe atomically
+ */
+typedef struct lcut_result_msg_t {
+    int                         index;
+    int                         status;
+    int                         line;
+    long long                   elapsed_ns;
+    long long                   wall_ns;
+    long long                   cpu_ns;
+    long long                   fixture_ns;
+    long long                   setup_ns;       /* the setup of the suite run before the case */
+    int                         teardown_suite; /* the suite torn down before the case, -1: none */
+    long long                   teardown_ns;
+    lcut_bench_t                bench;          /* the statistics of a benchmark case */
+    lcut_allocs_t               allocs;
+    lcut_perf_t                 perf;
+    long long                   asserts;
+    char                        fname[LCUT_MAX_NAME_LEN];
+    char                        fcname[LCUT_MAX_NAME_LEN];
+    char                        reason[LCUT_MAX_STR_LEN];
+    char                        detail[LCUT_MAX_DETAIL_LEN];
+} lcut_result_msg_t;
+
+/*
+ * the shared state of the thread runner and the private state of its threads
+ */
+typedef struct lcut_thread_t lcut_thread_t;
+
+typedef struct lcut_pool_t {
+    lcut_plan_t                 *plan;
+    lcut_sched_t                *sched;
+    pthread_mutex_t             lock;
+    pthread_cond_t              cond;       /* signaled when a case is finished */
+    int                         finished;   /* the count of finished cases */
+    lcut_thread_t               **threads;
+    int                         nthreads;
+    int                         capacity;
+} lcut_pool_t;
+
+struct lcut_thread_t {
+    lcut_pool_t                 *pool;
+    pthread_t                   tid;
+    int                         id;
+    int                         ran;        /* the count of cases run by the thread */
+    int                         failed;     /* the count of failed cases of the thread */
+    int                         current;    /* the case in flight, -1: none, guarded by pool lock */
+    long long                   started;    /* when the case in flight was started */
+    int                         state;      /* THREAD_IDLE, THREAD_RUNNING or THREAD_ABANDONED */
+};
+
+/*
+ * a running thread either finishes its case or gets abandoned by the
+ * watchdog, whichever swaps the state first
+ */
+enum {
+    THREAD_IDLE      = 0,
+    THREAD_RUNNING   = 1,
+    THREAD_ABANDONED = 2
+};
+
+typedef struct lcut_worker_t {
+    pid_t                       pid;
+    int                         cmd_fd;     /* parent -> worker: index of the case to run */
+    int                         res_fd;     /* worker -> parent: lcut_result_msg_t */
+    int                         busy;       /* index of the case in flight, -1 when idle */
+    long long                   deadline;   /* when the case in flight times out, 0: never */
+} lcut_worker_t;
+
+/*
+ * the mock symbol names interned for the process, an open addressing
+ * hash table giving out the ids which index the symbols of the threads
+ */
+typedef struct lcut_intern_t {
+    unsigned long long          hash;
+    const char                  *name;      /* NULL: empty slot */
+    int                         id;
+} lcut_intern_t;
+
+typedef struct lcut_interns_t {
+    lcut_intern_t               *slots;
+    size_t                      cap;        /* power of 2 */
+    int                         count;      /* the count of ids given out */
+    const char                  **names;    /* the names by id */
+    pthread_mutex_t             lock;
+} lcut_interns_t;
+
+static lcut_interns_t _interns = {NULL, 0, 0, NULL, PTHREAD_MUTEX_INITIALIZER};
+
+/*
+ * every thread has its own mock objects, indexed by id * 2 + obj_type
+ */
+typedef struct lcut_mocks_t {
+    lcut_symbol_t               **symbols;  /* NULL: no value returned to the symbol yet */
+    int                         cap;
+} lcut_mocks_t;
+
+static __thread lcut_mocks_t _mocks;
+
+/*
+ * the heap allocations of the case func running on a thread, told by the
+ * hooks of liblcut_alloc when the program links it, the blocks allocated
+ * by the func are kept in an open addressing table mapped out of the heap
+ */
+typedef struct lcut_block_t {
+    void                        *p;         /* NULL: empty slot */
+    size_t                      size;
+} lcut_block_t;
+
+typedef struct lcut_tracker_t {
+    volatile int                on;         /* 1: the case func is running, volatile as the
+                                               compiler assumes malloc leaves it alone */
+    lcut_allocs_t               allocs;
+    long long                   live;       /* the bytes allocated now */
+    lcut_block_t                *blocks;
+    size_t                      cap;        /* power of 2 */
+} lcut_tracker_t;
+
+#if defined(__GLIBC__)
+#define LCUT_ALLOC_HOOKS 1
+
+/* no lazy allocation of the tls, which would call malloc */
+static __thread lcut_tracker_t _tracker __attribute__((tls_model("initial-exec")));
 
-static lcut_symbol_t* lookup_symbol(const char *symbol_name, int obj_type);
+/* set before main by liblcut_alloc, read only after */
+static int _alloc_hooked = 0;
+#endif
+
+/*
+ * the perf event counters of the case funcs running on a thread, opened
+ * on the first case of the thread, one counter per event so that those
+ * the cpu cannot count together are multiplexed and scaled
+ */
+enum {
+    PERF_INSTRUCTIONS = 0,
+    PERF_CYCLES       = 1,
+    PERF_HARDWARE     = 5,      /* the count of the hardware events */
+    PERF_EVENTS       = 8
+};
+
+typedef struct lcut_perf_state_t {
+    pid_t                       tid;        /* the thread which opened the counters, 0: none */
+    int                         fds[PERF_EVENTS];   /* -1: the event is not counted */
+} lcut_perf_state_t;
+
+static __thread lcut_perf_state_t _perf;
+static int _perf_on;                        /* --perf */
+static unsigned long long _prop_seed;       /* --seed, or the one picked for the run */
+
+/* the serial runner's watchdog */
+static sigjmp_buf _timeout_jmp;
+static volatile sig_atomic_t _timeout_armed;
+
+static int test_env(lcut_test_t *test);
+static void writer_close(lcut_writer_t *w);
+static void mock_init(void);
+static void mock_clear(void);
+static int intern_symbol(const char *symbol_name);
+static lcut_symbol_t* lookup_symbol(int id, int obj_type, int create);
 static void add_value(lcut_symbol_t *s, void *value, int count);
-static lcut_value_t* get_value(lcut_symbol_t *s);
+static int get_value(lcut_symbol_t *s, void **value);
+static long long perf_read(int event);
+static int alloc_pause(void);
+static void alloc_resume(int on);
+static void results_write(lcut_plan_t *plan, lcut_plan_tc_t *c);
 
 #define RETURN_WHEN_FAILED(tc) do { \
     if ((tc)->status == TEST_CASE_FAILURE) { \
@@ -31,13 +384,180 @@ static lcut_value_t* get_value(lcut_symbol_t *s);
     } \
 } while(0)
 
-#define FILL_IN_FAILED_REASON(tc, fname, fcname, lineno, reason_fmt, ...) do { \
-    snprintf((tc)->fname, LCUT_MAX_NAME_LEN, "%s", (fname));         \
-    snprintf((tc)->fcname, LCUT_MAX_NAME_LEN, "%s", (fcname));       \
-    (tc)->line = (lineno); \
-    snprintf((tc)->reason, LCUT_MAX_STR_LEN, (reason_fmt), __VA_ARGS__); \
-    (tc)->status = TEST_CASE_FAILURE; \
-} while (0)
+#define FILL_IN_FAILED_REASON(tc, file, func, lineno, reason_fmt, ...) \
+    fail_case((tc), (file), (func), (lineno), (reason_fmt), __VA_ARGS__)
+
+/* reported when the failure of a case could not be recorded */
+static const lcut_failure_t _no_failure = {NULL, NULL, 0, "out of memory"};
+
+/*
+ * the failure record of a case, allocated on its first failure,
+ * which is not one of the allocations of the case func
+ */
+static lcut_failure_t* case_failure(lcut_tc_t *tc) {
+    int     on;
+
+    if (tc->failure == NULL) {
+        on = alloc_pause();
+        tc->failure = calloc(1, sizeof(lcut_failure_t));
+        alloc_resume(on);
+    }
+
+    return tc->failure;
+}
+
+/*
+ * file and func are literals, __FILE__ and __FUNCTION__ mostly, or NULL
+ * for a failure of no assertion, a crash or a timeout, which has no place
+ * in the code and is reported by its reason alone
+ */
+static void fail_case(lcut_tc_t *tc, const char *file, const char *func, int lineno,
+                      const char *reason_fmt, ...) {
+    lcut_failure_t  *f  = NULL;
+    va_list         ap;
+
+    tc->status = TEST_CASE_FAILURE;
+    if ((f = case_failure(tc)) == NULL) {
+        return;
+    }
+
+    f->fname  = file;
+    f->fcname = func;
+    f->line   = lineno;
+    va_start(ap, reason_fmt);
+    vsnprintf(f->reason, LCUT_MAX_STR_LEN, reason_fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * the failure comes from a worker or a results file, its names are copied
+ */
+static void fail_case_copy(lcut_tc_t *tc, const char *file, const char *func, int lineno,
+                           const char *reason) {
+    lcut_failure_t  *f  = NULL;
+
+    tc->status = TEST_CASE_FAILURE;
+    if ((f = case_failure(tc)) == NULL) {
+        return;
+    }
+
+    if (file == NULL || file[0] == '\0') {
+        f->fname  = NULL;
+        f->fcname = NULL;
+        f->line   = 0;
+        snprintf(f->reason, LCUT_MAX_STR_LEN, "%s", reason);
+        return;
+    }
+
+    snprintf(f->names, LCUT_MAX_NAME_LEN, "%s", file);
+    snprintf(f->names + LCUT_MAX_NAME_LEN, LCUT_MAX_NAME_LEN, "%s", func);
+    f->fname  = f->names;
+    f->fcname = f->names + LCUT_MAX_NAME_LEN;
+    f->line   = lineno;
+    snprintf(f->reason, LCUT_MAX_STR_LEN, "%s", reason);
+}
+
+static const lcut_failure_t* failure_of(lcut_tc_t *tc) {
+    return tc->failure != NULL ? tc->failure : &_no_failure;
+}
+
+/*
+ * the lines printed under the reason of a failed case
+ */
+static void failure_detail(lcut_tc_t *tc, const char *detail) {
+    int on;
+
+    if (tc->failure == NULL || tc->failure->detail != NULL || detail[0] == '\0') {
+        return;
+    }
+
+    on = alloc_pause();
+    tc->failure->detail = strdup(detail);
+    alloc_resume(on);
+}
+
+static void failure_free(lcut_tc_t *tc) {
+    if (tc->failure != NULL) {
+        free(tc->failure->detail);
+        free(tc->failure);
+        tc->failure = NULL;
+    }
+}
+
+/*
+ * the chunks of an arena start small and double up to LCUT_CHUNK_MAX,
+ * so that a suite of a few cases costs little and one of a million
+ * cases costs a few hundred mallocs
+ */
+#define LCUT_CHUNK_MIN  4096
+#define LCUT_CHUNK_MAX  (1024 * 1024)
+#define LCUT_ALIGN      16
+
+struct lcut_chunk_t {
+    lcut_chunk_t                *next;
+    size_t                      size;
+};
+
+static void* arena_alloc(lcut_arena_t *a, size_t size) {
+    lcut_chunk_t    *chunk  = NULL;
+    size_t          pad     = (LCUT_ALIGN - ((size_t)a->next & (LCUT_ALIGN - 1))) & (LCUT_ALIGN - 1);
+    size_t          want;
+    void            *p      = NULL;
+
+    if (a->next == NULL || pad + size > a->left) {
+        if (a->grow < LCUT_CHUNK_MIN) {
+            a->grow = LCUT_CHUNK_MIN;
+        }
+        want = size + 2 * LCUT_ALIGN > a->grow ? size + 2 * LCUT_ALIGN : a->grow;
+        if ((chunk = malloc(want)) == NULL) {
+            return NULL;
+        }
+        chunk->next = a->chunks;
+        chunk->size = want;
+        a->chunks   = chunk;
+        a->next     = (char*)chunk + LCUT_ALIGN;
+        a->left     = want - LCUT_ALIGN;
+        if (a->grow < LCUT_CHUNK_MAX) {
+            a->grow *= 2;
+        }
+        pad = 0;
+    }
+
+    p        = a->next + pad;
+    a->next += pad + size;
+    a->left -= pad + size;
+
+    return p;
+}
+
+static char* arena_strdup(lcut_arena_t *a, const char *str) {
+    size_t  len = strlen(str) + 1;
+    char    *p  = NULL;
+
+    /* strings need no alignment */
+    if (a->next != NULL && len <= a->left) {
+        p        = a->next;
+        a->next += len;
+        a->left -= len;
+    } else if ((p = arena_alloc(a, len)) == NULL) {
+        return NULL;
+    }
+
+    memcpy(p, str, len);
+    return p;
+}
+
+static void arena_free(lcut_arena_t *a) {
+    lcut_chunk_t    *chunk  = a->chunks;
+    lcut_chunk_t    *next   = NULL;
+
+    while (chunk != NULL) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(a, 0, sizeof(*a));
+}
                                   
 void lcut_int_equal(lcut_tc_t *tc,
                     const int expected,
@@ -106,218 +626,6256 @@ void lcut_str_nequal(lcut_tc_t *tc, const char *expected, const char *actual, in
                            actual ? actual : "NULL");
 }
 
-void lcut_assert(lcut_tc_t *tc, const char *msg, int condition,
-                 int lineno, const char *fcname, const char *fname) {
-    RETURN_WHEN_FAILED(tc);
+void lcut_assert(lcut_tc_t *tc, const char *msg, int condition,
+                 int lineno, const char *fcname, const char *fname) {
+    RETURN_WHEN_FAILED(tc);
+
+    if (condition) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "%s",
+                          msg);
+}
+
+/*
+ * the allocation checks fail when nothing counts the allocations,
+ * rather than pass whatever the func does
+ */
+static int alloc_unhooked(lcut_tc_t *tc, int lineno, const char *fcname, const char *fname) {
+#ifdef LCUT_ALLOC_HOOKS
+    if (_alloc_hooked) {
+        return 0;
+    }
+#endif
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "%s",
+                          "allocation tracking not linked, link with -llcut_alloc");
+    return 1;
+}
+
+void lcut_allocs_le(lcut_tc_t *tc, long long n,
+                    int lineno, const char *fcname, const char *fname) {
+    RETURN_WHEN_FAILED(tc);
+
+    if (alloc_unhooked(tc, lineno, fcname, fname)) {
+        return;
+    }
+
+#ifdef LCUT_ALLOC_HOOKS
+    if (_tracker.allocs.count <= n) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "allocations<%lld> > expected<%lld>",
+                          _tracker.allocs.count, n);
+#endif
+}
+
+void lcut_instructions_le(lcut_tc_t *tc, long long n,
+                          int lineno, const char *fcname, const char *fname) {
+    long long   count;
+
+    RETURN_WHEN_FAILED(tc);
+
+    if ((count = perf_read(PERF_INSTRUCTIONS)) < 0 || count <= n) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "instructions<%lld> > expected<%lld>",
+                          count, n);
+}
+
+void lcut_cycles_le(lcut_tc_t *tc, long long n,
+                    int lineno, const char *fcname, const char *fname) {
+    long long   count;
+
+    RETURN_WHEN_FAILED(tc);
+
+    if ((count = perf_read(PERF_CYCLES)) < 0 || count <= n) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "cycles<%lld> > expected<%lld>",
+                          count, n);
+}
+
+void lcut_no_leaks(lcut_tc_t *tc,
+                   int lineno, const char *fcname, const char *fname) {
+    RETURN_WHEN_FAILED(tc);
+
+    if (alloc_unhooked(tc, lineno, fcname, fname)) {
+        return;
+    }
+
+#ifdef LCUT_ALLOC_HOOKS
+    if (_tracker.allocs.leaks == 0) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "%lld blocks of %lld bytes not freed",
+                          _tracker.allocs.leaks, _tracker.live);
+#endif
+}
+
+void lcut_true(lcut_tc_t *tc, int condition,
+               int lineno, const char *fcname, const char *fname) {
+    RETURN_WHEN_FAILED(tc);
+
+    if (condition) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "%s",
+                          "");
+}
+
+/*
+ * the vector extensions the kernels below can use, probed once
+ */
+enum {
+    SIMD_NONE = 0,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+static int simd_level(void) {
+    static int  level   = -1;
+
+    if (level < 0) {
+#ifdef LCUT_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            level = SIMD_AVX2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            level = SIMD_SSE2;
+        } else
+#endif
+        level = SIMD_NONE;
+    }
+
+    return level;
+}
+
+/*
+ * the offset of the first byte which differs, len when none
+ */
+typedef size_t (*mismatch_func)(const unsigned char *a, const unsigned char *b, size_t len);
+
+static size_t mismatch_scalar(const unsigned char *a, const unsigned char *b, size_t len) {
+    unsigned long long  x, y;
+    size_t              i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) {
+            break;
+        }
+    }
+    for (; i < len && a[i] == b[i]; i++) {
+        ;
+    }
+
+    return i;
+}
+
+#ifdef LCUT_X86_SIMD
+__attribute__((target("sse2")))
+static size_t mismatch_sse2(const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t  i = 0;
+    int     m;
+
+    for (; i + 16 <= len; i += 16) {
+        m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),
+                                             _mm_loadu_si128((const __m128i*)(b + i))));
+        if (m != 0xffff) {
+            return i + __builtin_ctz(~m);
+        }
+    }
+
+    return i + mismatch_scalar(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch_avx2(const unsigned char *a, const unsigned char *b, size_t len) {
+    __m256i     e0, e1;
+    size_t      i = 0;
+    unsigned    m;
+
+    /* 64 bytes a round, the round with the mismatch is looked into below */
+    for (; i + 64 <= len; i += 64) {
+        e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)),
+                               _mm256_loadu_si256((const __m256i*)(b + i)));
+        e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i + 32)),
+                               _mm256_loadu_si256((const __m256i*)(b + i + 32)));
+        if ((unsigned)_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) != 0xffffffffU) {
+            break;
+        }
+    }
+    for (; i + 32 <= len; i += 32) {
+        m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                                             _mm256_loadu_si256((const __m256i*)(b + i))));
+        if (m != 0xffffffffU) {
+            return i + __builtin_ctz(~m);
+        }
+    }
+
+    return i + mismatch_scalar(a + i, b + i, len - i);
+}
+#endif
+
+/*
+ * picked for the cpu on the first call
+ */
+static size_t mem_mismatch(const void *a, const void *b, size_t len) {
+    static mismatch_func    mismatch    = NULL;
+
+    if (mismatch == NULL) {
+        switch (simd_level()) {
+#ifdef LCUT_X86_SIMD
+        case SIMD_AVX2: mismatch = mismatch_avx2; break;
+        case SIMD_SSE2: mismatch = mismatch_sse2; break;
+#endif
+        default: mismatch = mismatch_scalar; break;
+        }
+    }
+
+    return mismatch(a, b, len);
+}
+
+/*
+ * the count of the elements of size bytes which differ, from the one
+ * holding the byte first
+ */
+static size_t mismatch_count(const unsigned char *e, const unsigned char *a, size_t len,
+                             size_t size, size_t first) {
+    size_t  count   = 0;
+    size_t  pos     = first / size * size;
+
+    while (pos < len) {
+        pos += mem_mismatch(e + pos, a + pos, len - pos);
+        if (pos >= len) {
+            break;
+        }
+        count++;
+        pos = (pos / size + 1) * size;
+    }
+
+    return count;
+}
+
+/*
+ * the rows of 16 bytes around off, expected over actual, and the bytes
+ * which differ marked under them
+ */
+static void hexdump_diff(char *buf, size_t len, const unsigned char *e, const unsigned char *a,
+                         size_t total, size_t off) {
+    size_t  row     = off / 16 * 16;
+    size_t  start   = row >= 16 ? row - 16 : 0;
+    size_t  end     = row + 32 < total ? row + 32 : total;
+    size_t  n       = 0;
+    size_t  r, i, last;
+    int     differ;
+
+    for (r = start; r < end && n < len; r += 16) {
+        n += snprintf(buf + n, len - n, "\t\t\t%08zx  expected ", r);
+        for (i = r; i < r + 16 && i < end && n < len; i++) {
+            n += snprintf(buf + n, len - n, " %02x", e[i]);
+        }
+        if (n < len) {
+            n += snprintf(buf + n, len - n, "\n\t\t\t%8s  actual   ", "");
+        }
+        for (differ = 0, last = r, i = r; i < r + 16 && i < end && n < len; i++) {
+            n += snprintf(buf + n, len - n, " %02x", a[i]);
+            if (e[i] != a[i]) {
+                differ = 1;
+                last   = i;
+            }
+        }
+        if (differ && n < len) {
+            n += snprintf(buf + n, len - n, "\n\t\t\t%8s           ", "");
+            for (i = r; i <= last && n < len; i++) {
+                n += snprintf(buf + n, len - n, "%s", e[i] != a[i] ? " ^^" : "   ");
+            }
+        }
+        if (n < len) {
+            n += snprintf(buf + n, len - n, "\n");
+        }
+    }
+}
+
+static long long element_of(const unsigned char *p, size_t size) {
+    signed char i8;
+    short       i16;
+    int         i32;
+    long long   i64;
+
+    switch (size) {
+    case 1: memcpy(&i8, p, 1); return i8;
+    case 2: memcpy(&i16, p, 2); return i16;
+    case 4: memcpy(&i32, p, 4); return i32;
+    default: memcpy(&i64, p, 8); return i64;
+    }
+}
+
+/*
+ * the integer elements around index, those which differ marked
+ */
+static void elements_diff(char *buf, size_t len, const unsigned char *e, const unsigned char *a,
+                          size_t count, size_t size, size_t index) {
+    size_t              start   = index >= 2 ? index - 2 : 0;
+    size_t              end     = index + 6 < count ? index + 6 : count;
+    size_t              n       = 0;
+    unsigned long long  mask    = size == 8 ? ~0ULL : (1ULL << (size * 8)) - 1;
+    long long           x, y;
+    size_t              i;
+
+    for (i = start; i < end && n < len; i++) {
+        x  = element_of(e + i * size, size);
+        y  = element_of(a + i * size, size);
+        n += snprintf(buf + n, len - n, "\t\t\t[%zu] expected %lld (0x%0*llx), actual %lld (0x%0*llx)%s\n",
+                      i, x, (int)size * 2, (unsigned long long)x & mask,
+                      y, (int)size * 2, (unsigned long long)y & mask, x != y ? "  <-" : "");
+    }
+}
+
+void lcut_mem_equal(lcut_tc_t *tc, const void *expected, const void *actual, size_t len,
+                    int lineno, const char *fcname, const char *fname) {
+    char    detail[LCUT_MAX_DETAIL_LEN];
+    size_t  off;
+
+    RETURN_WHEN_FAILED(tc);
+
+    if (expected == actual || len == 0) {
+        return;
+    }
+
+    if (expected == NULL || actual == NULL) {
+        FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                              "expected<%s> : actual<%s>",
+                              expected ? "buffer" : "NULL", actual ? "buffer" : "NULL");
+        return;
+    }
+
+    if ((off = mem_mismatch(expected, actual, len)) == len) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "memory differs at byte %zu of %zu, %zu bytes differ",
+                          off, len, mismatch_count(expected, actual, len, 1, off));
+    hexdump_diff(detail, sizeof(detail), expected, actual, len, off);
+    failure_detail(tc, detail);
+}
+
+void lcut_array_equal(lcut_tc_t *tc, const void *expected, const void *actual, size_t count,
+                      size_t size, int lineno, const char *fcname, const char *fname) {
+    char    detail[LCUT_MAX_DETAIL_LEN];
+    size_t  len = count * size;
+    size_t  off;
+
+    RETURN_WHEN_FAILED(tc);
+
+    if (expected == actual || len == 0) {
+        return;
+    }
+
+    if (expected == NULL || actual == NULL) {
+        FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                              "expected<%s> : actual<%s>",
+                              expected ? "array" : "NULL", actual ? "array" : "NULL");
+        return;
+    }
+
+    if ((off = mem_mismatch(expected, actual, len)) == len) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "arrays differ at index %zu of %zu, %zu elements differ",
+                          off / size, count, mismatch_count(expected, actual, len, size, off));
+    if (size == 1 || size == 2 || size == 4 || size == 8) {
+        elements_diff(detail, sizeof(detail), expected, actual, count, size, off / size);
+    } else {
+        hexdump_diff(detail, sizeof(detail), expected, actual, len, off);
+    }
+    failure_detail(tc, detail);
+}
+
+/*
+ * the floating point checks below. the kernels only tell whether any
+ * element fails, the cold path walks the arrays again for the count,
+ * the worst element and the ones around it. an element fails when it
+ * is not within the tolerance and not equal, so NaN always fails and
+ * equal infinities pass
+ */
+typedef int (*near_f32_func)(const float *e, const float *a, size_t n, float abs_tol, float rel_tol);
+typedef int (*near_f64_func)(const double *e, const double *a, size_t n, double abs_tol, double rel_tol);
+typedef int (*ulp_f32_func)(const float *e, const float *a, size_t n, long long ulps);
+typedef int (*ulp_f64_func)(const double *e, const double *a, size_t n, long long ulps);
+
+static int near_f32_scalar(const float *e, const float *a, size_t n, float abs_tol, float rel_tol) {
+    size_t  i;
+    int     fail    = 0;
+
+    for (i = 0; i < n; i++) {
+        fail |= !(fabsf(a[i] - e[i]) <= abs_tol + rel_tol * fabsf(e[i])) & (a[i] != e[i]);
+    }
+
+    return fail;
+}
+
+static int near_f64_scalar(const double *e, const double *a, size_t n, double abs_tol, double rel_tol) {
+    size_t  i;
+    int     fail    = 0;
+
+    for (i = 0; i < n; i++) {
+        fail |= !(fabs(a[i] - e[i]) <= abs_tol + rel_tol * fabs(e[i])) & (a[i] != e[i]);
+    }
+
+    return fail;
+}
+
+/*
+ * the bits of x mapped onto an unsigned scale in the order of the
+ * values, -0.0 and 0.0 on the same point, so the ulps between two
+ * values are the distance between their keys
+ */
+static unsigned int ulp_key_f32(float x) {
+    unsigned int    b;
+
+    memcpy(&b, &x, sizeof(b));
+    return b >> 31 ? 0x80000000U - (b & 0x7fffffffU) : 0x80000000U + b;
+}
+
+static unsigned long long ulp_key_f64(double x) {
+    unsigned long long  b;
+
+    memcpy(&b, &x, sizeof(b));
+    return b >> 63 ? 0x8000000000000000ULL - (b & 0x7fffffffffffffffULL) : 0x8000000000000000ULL + b;
+}
+
+static unsigned long long ulps_f32(float e, float a) {
+    unsigned int    x   = ulp_key_f32(e);
+    unsigned int    y   = ulp_key_f32(a);
+
+    return x > y ? x - y : y - x;
+}
+
+static unsigned long long ulps_f64(double e, double a) {
+    unsigned long long  x   = ulp_key_f64(e);
+    unsigned long long  y   = ulp_key_f64(a);
+
+    return x > y ? x - y : y - x;
+}
+
+static int ulp_f32_scalar(const float *e, const float *a, size_t n, long long ulps) {
+    size_t  i;
+    int     fail    = 0;
+
+    for (i = 0; i < n; i++) {
+        fail |= (ulps_f32(e[i], a[i]) > (unsigned long long)ulps) | isnan(e[i]) | isnan(a[i]);
+    }
+
+    return fail;
+}
+
+static int ulp_f64_scalar(const double *e, const double *a, size_t n, long long ulps) {
+    size_t  i;
+    int     fail    = 0;
+
+    for (i = 0; i < n; i++) {
+        fail |= (ulps_f64(e[i], a[i]) > (unsigned long long)ulps) | isnan(e[i]) | isnan(a[i]);
+    }
+
+    return fail;
+}
+
+#ifdef LCUT_X86_SIMD
+__attribute__((target("sse2")))
+static int near_f32_sse2(const float *e, const float *a, size_t n, float abs_tol, float rel_tol) {
+    __m128  sign    = _mm_set1_ps(-0.0f);
+    __m128  at      = _mm_set1_ps(abs_tol);
+    __m128  rt      = _mm_set1_ps(rel_tol);
+    __m128  ok      = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128  x, y, d, t;
+    size_t  i       = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        x  = _mm_loadu_ps(e + i);
+        y  = _mm_loadu_ps(a + i);
+        d  = _mm_andnot_ps(sign, _mm_sub_ps(y, x));
+        t  = _mm_add_ps(at, _mm_mul_ps(rt, _mm_andnot_ps(sign, x)));
+        ok = _mm_and_ps(ok, _mm_or_ps(_mm_cmple_ps(d, t), _mm_cmpeq_ps(x, y)));
+    }
+
+    return _mm_movemask_ps(ok) != 0xf || near_f32_scalar(e + i, a + i, n - i, abs_tol, rel_tol);
+}
+
+__attribute__((target("sse2")))
+static int near_f64_sse2(const double *e, const double *a, size_t n, double abs_tol, double rel_tol) {
+    __m128d sign    = _mm_set1_pd(-0.0);
+    __m128d at      = _mm_set1_pd(abs_tol);
+    __m128d rt      = _mm_set1_pd(rel_tol);
+    __m128d ok      = _mm_castsi128_pd(_mm_set1_epi32(-1));
+    __m128d x, y, d, t;
+    size_t  i       = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        x  = _mm_loadu_pd(e + i);
+        y  = _mm_loadu_pd(a + i);
+        d  = _mm_andnot_pd(sign, _mm_sub_pd(y, x));
+        t  = _mm_add_pd(at, _mm_mul_pd(rt, _mm_andnot_pd(sign, x)));
+        ok = _mm_and_pd(ok, _mm_or_pd(_mm_cmple_pd(d, t), _mm_cmpeq_pd(x, y)));
+    }
+
+    return _mm_movemask_pd(ok) != 0x3 || near_f64_scalar(e + i, a + i, n - i, abs_tol, rel_tol);
+}
+
+__attribute__((target("avx2")))
+static int near_f32_avx2(const float *e, const float *a, size_t n, float abs_tol, float rel_tol) {
+    __m256  sign    = _mm256_set1_ps(-0.0f);
+    __m256  at      = _mm256_set1_ps(abs_tol);
+    __m256  rt      = _mm256_set1_ps(rel_tol);
+    __m256  ok      = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    __m256  x, y, d, t;
+    size_t  i       = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        x  = _mm256_loadu_ps(e + i);
+        y  = _mm256_loadu_ps(a + i);
+        d  = _mm256_andnot_ps(sign, _mm256_sub_ps(y, x));
+        t  = _mm256_add_ps(at, _mm256_mul_ps(rt, _mm256_andnot_ps(sign, x)));
+        ok = _mm256_and_ps(ok, _mm256_or_ps(_mm256_cmp_ps(d, t, _CMP_LE_OQ),
+                                            _mm256_cmp_ps(x, y, _CMP_EQ_OQ)));
+    }
+
+    return _mm256_movemask_ps(ok) != 0xff || near_f32_scalar(e + i, a + i, n - i, abs_tol, rel_tol);
+}
+
+__attribute__((target("avx2")))
+static int near_f64_avx2(const double *e, const double *a, size_t n, double abs_tol, double rel_tol) {
+    __m256d sign    = _mm256_set1_pd(-0.0);
+    __m256d at      = _mm256_set1_pd(abs_tol);
+    __m256d rt      = _mm256_set1_pd(rel_tol);
+    __m256d ok      = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+    __m256d x, y, d, t;
+    size_t  i       = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        x  = _mm256_loadu_pd(e + i);
+        y  = _mm256_loadu_pd(a + i);
+        d  = _mm256_andnot_pd(sign, _mm256_sub_pd(y, x));
+        t  = _mm256_add_pd(at, _mm256_mul_pd(rt, _mm256_andnot_pd(sign, x)));
+        ok = _mm256_and_pd(ok, _mm256_or_pd(_mm256_cmp_pd(d, t, _CMP_LE_OQ),
+                                            _mm256_cmp_pd(x, y, _CMP_EQ_OQ)));
+    }
+
+    return _mm256_movemask_pd(ok) != 0xf || near_f64_scalar(e + i, a + i, n - i, abs_tol, rel_tol);
+}
+
+/*
+ * the keys of ulp_key_f32 for 8 floats, widened to 64 bits in two
+ * halves so their distance cannot wrap
+ */
+__attribute__((target("avx2")))
+static __m256i ulp_keys_f32_avx2(__m256i b) {
+    __m256i s   = _mm256_srai_epi32(b, 31);
+    __m256i m   = _mm256_and_si256(b, _mm256_set1_epi32(0x7fffffff));
+
+    return _mm256_add_epi32(_mm256_sub_epi32(_mm256_xor_si256(m, s), s),
+                            _mm256_set1_epi32((int)0x80000000U));
+}
+
+__attribute__((target("avx2")))
+static __m256i ulp_abs_epi64_avx2(__m256i d) {
+    __m256i s   = _mm256_cmpgt_epi64(_mm256_setzero_si256(), d);
+
+    return _mm256_sub_epi64(_mm256_xor_si256(d, s), s);
+}
+
+__attribute__((target("avx2")))
+static int ulp_f32_avx2(const float *e, const float *a, size_t n, long long ulps) {
+    __m256i lim     = _mm256_set1_epi64x(ulps);
+    __m256i fail    = _mm256_setzero_si256();
+    __m256  x, y;
+    __m256i kx, ky, d0, d1;
+    size_t  i       = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        x    = _mm256_loadu_ps(e + i);
+        y    = _mm256_loadu_ps(a + i);
+        kx   = ulp_keys_f32_avx2(_mm256_castps_si256(x));
+        ky   = ulp_keys_f32_avx2(_mm256_castps_si256(y));
+        d0   = _mm256_sub_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(ky)),
+                                _mm256_cvtepu32_epi64(_mm256_castsi256_si128(kx)));
+        d1   = _mm256_sub_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(ky, 1)),
+                                _mm256_cvtepu32_epi64(_mm256_extracti128_si256(kx, 1)));
+        fail = _mm256_or_si256(fail, _mm256_cmpgt_epi64(ulp_abs_epi64_avx2(d0), lim));
+        fail = _mm256_or_si256(fail, _mm256_cmpgt_epi64(ulp_abs_epi64_avx2(d1), lim));
+        fail = _mm256_or_si256(fail, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_UNORD_Q)));
+    }
+
+    return !_mm256_testz_si256(fail, fail) || ulp_f32_scalar(e + i, a + i, n - i, ulps);
+}
+
+__attribute__((target("avx2")))
+static int ulp_f64_avx2(const double *e, const double *a, size_t n, long long ulps) {
+    __m256i top     = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    __m256i lim     = _mm256_xor_si256(_mm256_set1_epi64x(ulps), top);
+    __m256i zero    = _mm256_setzero_si256();
+    __m256i fail    = zero;
+    __m256d x, y;
+    __m256i bx, by, sx, sy, kx, ky, gt, d;
+    size_t  i       = 0;
+
+    /* unsigned compares flip the top bit and compare signed */
+    for (; i + 4 <= n; i += 4) {
+        x    = _mm256_loadu_pd(e + i);
+        y    = _mm256_loadu_pd(a + i);
+        bx   = _mm256_castpd_si256(x);
+        by   = _mm256_castpd_si256(y);
+        sx   = _mm256_cmpgt_epi64(zero, bx);
+        sy   = _mm256_cmpgt_epi64(zero, by);
+        kx   = _mm256_sub_epi64(_mm256_xor_si256(_mm256_andnot_si256(top, bx), sx), sx);
+        ky   = _mm256_sub_epi64(_mm256_xor_si256(_mm256_andnot_si256(top, by), sy), sy);
+        gt   = _mm256_cmpgt_epi64(kx, ky);
+        d    = _mm256_blendv_epi8(_mm256_sub_epi64(ky, kx), _mm256_sub_epi64(kx, ky), gt);
+        fail = _mm256_or_si256(fail, _mm256_cmpgt_epi64(_mm256_xor_si256(d, top), lim));
+        fail = _mm256_or_si256(fail, _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_UNORD_Q)));
+    }
+
+    return !_mm256_testz_si256(fail, fail) || ulp_f64_scalar(e + i, a + i, n - i, ulps);
+}
+#endif
+
+/*
+ * one of the array checks, read back element by element on a failure
+ */
+typedef struct lcut_fp_check_t {
+    const void  *expected;
+    const void  *actual;
+    size_t      count;
+    int         single;             /* float, or double */
+    int         ulp;                /* in ulps, or within abs_tol and rel_tol */
+    double      abs_tol;
+    double      rel_tol;
+    long long   ulps;
+} lcut_fp_check_t;
+
+static double fp_at(const void *p, int single, size_t i) {
+    return single ? ((const float*)p)[i] : ((const double*)p)[i];
+}
+
+/*
+ * the error of element i in the unit of the check, NaN when one of the
+ * elements is NaN, judged the way the kernels judge it
+ */
+static double fp_error(const lcut_fp_check_t *c, size_t i, int *failed) {
+    double              e   = fp_at(c->expected, c->single, i);
+    double              a   = fp_at(c->actual, c->single, i);
+    unsigned long long  u;
+    float               fe, fa;
+
+    if (isnan(e) || isnan(a)) {
+        *failed = 1;
+        return NAN;
+    }
+
+    if (c->ulp) {
+        u       = c->single ? ulps_f32((float)e, (float)a) : ulps_f64(e, a);
+        *failed = u > (unsigned long long)c->ulps;
+        return (double)u;
+    }
+
+    if (c->single) {
+        fe      = (float)e;
+        fa      = (float)a;
+        *failed = !(fabsf(fa - fe) <= (float)c->abs_tol + (float)c->rel_tol * fabsf(fe)) && fa != fe;
+    } else {
+        *failed = !(fabs(a - e) <= c->abs_tol + c->rel_tol * fabs(e)) && a != e;
+    }
+
+    return e == a ? 0.0 : fabs(a - e);
+}
+
+static int fp_format(char *buf, size_t len, const lcut_fp_check_t *c, double v) {
+    return snprintf(buf, len, c->single ? "%.9g" : "%.17g", v);
+}
+
+static int fp_format_error(char *buf, size_t len, const lcut_fp_check_t *c, double err) {
+    if (isnan(err)) {
+        return snprintf(buf, len, "NaN");
+    }
+    if (isinf(err)) {
+        return snprintf(buf, len, "inf");
+    }
+    return c->ulp ? snprintf(buf, len, "%.0f ulps", err) : snprintf(buf, len, "%.3g", err);
+}
+
+static void fp_check_failed(lcut_tc_t *tc, const lcut_fp_check_t *c,
+                            int lineno, const char *fcname, const char *fname) {
+    char    detail[LCUT_MAX_DETAIL_LEN];
+    char    ev[32], av[32], err[32];
+    size_t  worst   = 0;
+    size_t  count   = 0;
+    double  max     = -1.0;
+    double  x;
+    size_t  i, start, end, n;
+    int     failed;
+
+    for (i = 0; i < c->count; i++) {
+        x = fp_error(c, i, &failed);
+        if (failed) {
+            count++;
+            /* a NaN is the worst, then the largest error, inf included */
+            if ((isnan(x) && !isnan(max)) || x > max) {
+                max   = x;
+                worst = i;
+            }
+        }
+    }
+
+    fp_format(ev, sizeof(ev), c, fp_at(c->expected, c->single, worst));
+    fp_format(av, sizeof(av), c, fp_at(c->actual, c->single, worst));
+    fp_format_error(err, sizeof(err), c, max);
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "%zu of %zu elements out of tolerance, the worst at index %zu: "
+                          "expected<%s> : actual<%s>, error %s",
+                          count, c->count, worst, ev, av, err);
+
+    start = worst >= 2 ? worst - 2 : 0;
+    end   = worst + 6 < c->count ? worst + 6 : c->count;
+    for (n = 0, i = start; i < end && n < sizeof(detail); i++) {
+        x = fp_error(c, i, &failed);
+        fp_format(ev, sizeof(ev), c, fp_at(c->expected, c->single, i));
+        fp_format(av, sizeof(av), c, fp_at(c->actual, c->single, i));
+        fp_format_error(err, sizeof(err), c, x);
+        n += snprintf(detail + n, sizeof(detail) - n, "\t\t\t[%zu] expected %s, actual %s, error %s%s\n",
+                      i, ev, av, err, failed ? "  <-" : "");
+    }
+    failure_detail(tc, detail);
+}
+
+/*
+ * the checks common to the array forms, 1 when the arrays are left to
+ * the kernels
+ */
+static int fp_check_arrays(lcut_tc_t *tc, const lcut_fp_check_t *c,
+                           int lineno, const char *fcname, const char *fname) {
+    if (c->expected == c->actual || c->count == 0) {
+        return 0;
+    }
+
+    if (c->expected == NULL || c->actual == NULL) {
+        FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                              "expected<%s> : actual<%s>",
+                              c->expected ? "array" : "NULL", c->actual ? "array" : "NULL");
+        return 0;
+    }
+
+    if ((c->ulp && c->ulps < 0) || (!c->ulp && (!(c->abs_tol >= 0) || !(c->rel_tol >= 0)))) {
+        FILL_IN_FAILED_REASON(tc, fname, fcname, lineno, "%s", "invalid tolerance");
+        return 0;
+    }
+
+    return 1;
+}
+
+void lcut_double_near(lcut_tc_t *tc, double expected, double actual, double tolerance,
+                      int lineno, const char *fcname, const char *fname) {
+    RETURN_WHEN_FAILED(tc);
+
+    if (expected == actual || (fabs(actual - expected) <= tolerance)) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "expected<%.17g> : actual<%.17g>, error %.3g > tolerance %.3g",
+                          expected, actual, fabs(actual - expected), tolerance);
+}
+
+void lcut_double_ulp_equal(lcut_tc_t *tc, double expected, double actual, long long ulps,
+                           int lineno, const char *fcname, const char *fname) {
+    unsigned long long  u;
+
+    RETURN_WHEN_FAILED(tc);
+
+    u = ulps_f64(expected, actual);
+    if (!isnan(expected) && !isnan(actual) && ulps >= 0 && u <= (unsigned long long)ulps) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "expected<%.17g> : actual<%.17g>, %llu ulps apart > %lld",
+                          expected, actual, u, ulps);
+}
+
+void lcut_float_ulp_equal(lcut_tc_t *tc, float expected, float actual, long long ulps,
+                          int lineno, const char *fcname, const char *fname) {
+    unsigned long long  u;
+
+    RETURN_WHEN_FAILED(tc);
+
+    u = ulps_f32(expected, actual);
+    if (!isnan(expected) && !isnan(actual) && ulps >= 0 && u <= (unsigned long long)ulps) {
+        return;
+    }
+
+    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
+                          "expected<%.9g> : actual<%.9g>, %llu ulps apart > %lld",
+                          expected, actual, u, ulps);
+}
+
+void lcut_float_array_near(lcut_tc_t *tc, const float *expected, const float *actual, size_t count,
+                           double abs_tol, double rel_tol,
+                           int lineno, const char *fcname, const char *fname) {
+    static near_f32_func    near    = NULL;
+    lcut_fp_check_t         c       = {expected, actual, count, 1, 0, abs_tol, rel_tol, 0};
+
+    RETURN_WHEN_FAILED(tc);
+
+    if (near == NULL) {
+        switch (simd_level()) {
+#ifdef LCUT_X86_SIMD
+        case SIMD_AVX2: near = near_f32_avx2; break;
+        case SIMD_SSE2: near = near_f32_sse2; break;
+#endif
+        default: near = near_f32_scalar; break;
+        }
+    }
+
+    if (fp_check_arrays(tc, &c, lineno, fcname, fname) &&
+        near(expected, actual, count, (float)abs_tol, (float)rel_tol)) {
+        fp_check_failed(tc, &c, lineno, fcname, fname);
+    }
+}
+
+void lcut_double_array_near(lcut_tc_t *tc, const double *expected, const double *actual, size_t count,
+                            double abs_tol, double rel_tol,
+                            int lineno, const char *fcname, const char *fname) {
+    static near_f64_func    near    = NULL;
+    lcut_fp_check_t         c       = {expected, actual, count, 0, 0, abs_tol, rel_tol, 0};
+
+    RETURN_WHEN_FAILED(tc);
+
+    if (near == NULL) {
+        switch (simd_level()) {
+#ifdef LCUT_X86_SIMD
+        case SIMD_AVX2: near = near_f64_avx2; break;
+        case SIMD_SSE2: near = near_f64_sse2; break;
+#endif
+        default: near = near_f64_scalar; break;
+        }
+    }
+
+    if (fp_check_arrays(tc, &c, lineno, fcname, fname) &&
+        near(expected, actual, count, abs_tol, rel_tol)) {
+        fp_check_failed(tc, &c, lineno, fcname, fname);
+    }
+}
+
+void lcut_float_array_ulp(lcut_tc_t *tc, const float *expected, const float *actual, size_t count,
+                          long long ulps, int lineno, const char *fcname, const char *fname) {
+    static ulp_f32_func ulp = NULL;
+    lcut_fp_check_t     c   = {expected, actual, count, 1, 1, 0.0, 0.0, ulps};
+
+    RETURN_WHEN_FAILED(tc);
+
+    /* SSE2 has no 64 bit compares, it is left to the scalar loop */
+    if (ulp == NULL) {
+#ifdef LCUT_X86_SIMD
+        ulp = simd_level() == SIMD_AVX2 ? ulp_f32_avx2 : ulp_f32_scalar;
+#else
+        ulp = ulp_f32_scalar;
+#endif
+    }
+
+    if (fp_check_arrays(tc, &c, lineno, fcname, fname) && ulp(expected, actual, count, ulps)) {
+        fp_check_failed(tc, &c, lineno, fcname, fname);
+    }
+}
+
+void lcut_double_array_ulp(lcut_tc_t *tc, const double *expected, const double *actual, size_t count,
+                           long long ulps, int lineno, const char *fcname, const char *fname) {
+    static ulp_f64_func ulp = NULL;
+    lcut_fp_check_t     c   = {expected, actual, count, 0, 1, 0.0, 0.0, ulps};
+
+    RETURN_WHEN_FAILED(tc);
+
+    if (ulp == NULL) {
+#ifdef LCUT_X86_SIMD
+        ulp = simd_level() == SIMD_AVX2 ? ulp_f64_avx2 : ulp_f64_scalar;
+#else
+        ulp = ulp_f64_scalar;
+#endif
+    }
+
+    if (fp_check_arrays(tc, &c, lineno, fcname, fname) && ulp(expected, actual, count, ulps)) {
+        fp_check_failed(tc, &c, lineno, fcname, fname);
+    }
+}
+
+int lcut_test_init(lcut_test_t **test, const char *title, fixture_func setup, fixture_func teardown) {
+    int		        rv	= 0;
+    lcut_test_t		*p	= NULL;
+
+    p = malloc(sizeof(*p));
+    if (p == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        return rv;
+    }
+
+    memset(p, 0, sizeof(lcut_test_t));
+    APR_RING_INIT(&(p->ts_head), lcut_ts_t, link);
+    strncpy(p->desc, title, LCUT_MAX_NAME_LEN);
+    p->setup = setup;
+    p->teardown = teardown;
+
+    p->jobs = 1;
+    p->top  = 5;
+    p->bench_samples = 100;
+    p->max_regression = 10;
+
+    mock_init();
+
+    if ((rv = test_env(p)) != 0) {
+        free(p);
+        return rv;
+    }
+
+    (*test) = p;
+
+    return rv;
+}
+
+void lcut_test_destroy(lcut_test_t **test) {
+    lcut_test_t     *p      = (*test);
+    lcut_ts_t       *ts     = NULL;
+    lcut_tc_t       *tc     = NULL;
+    lcut_reporter_t *r      = NULL;
+    lcut_reporter_t *next   = NULL;
+
+    mock_clear();
+    free(p->merge);
+
+    for (r = p->reporters; r != NULL; r = next) {
+        next = r->next;
+        writer_close(r->out);
+        r->out = NULL;
+        if (r->destroy != NULL) {
+            r->destroy(r);
+        }
+    }
+
+    while (!APR_RING_EMPTY(&(p->ts_head), lcut_ts_t, link)) {
+        ts = APR_RING_FIRST(&(p->ts_head));
+        if (ts != NULL) {
+            /* the cases live in the arena of the suite, but their failures */
+            APR_RING_FOREACH(tc, &(ts->tc_head), lcut_tc_t, link) {
+                failure_free(tc);
+            }
+            arena_free(&(ts->arena));
+        }
+        APR_RING_REMOVE(ts, link);
+        free(ts);
+        ts = NULL;
+    }
+
+    free(p);
+    (*test) = NULL;
+}
+
+int lcut_ts_init(lcut_ts_t **ts, const char *title, fixture_func setup, fixture_func teardown) {
+    int         rv = 0;
+    lcut_ts_t	*p = NULL;
+
+    p = malloc(sizeof(lcut_ts_t));
+    if (p == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d] n", errno);
+        return rv;
+    }
+    memset(p, 0, sizeof(lcut_ts_t));
+    APR_RING_INIT(&(p->tc_head), lcut_tc_t, link);
+    if ((p->desc = arena_strdup(&(p->arena), title)) == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", rv);
+        free(p);
+        return rv;
+    }
+    p->ran      = 0;
+    p->failed   = 0;
+    p->setup    = setup;
+    p->teardown = teardown;
+
+    (*ts) = p;
+
+    return rv;
+}
+
+void lcut_ts_add(lcut_test_t *test, lcut_ts_t *ts) {
+    lcut_ts_t	*p = ts;
+
+    APR_RING_ELEM_INIT(p, link);
+    APR_RING_INSERT_TAIL(&(test->ts_head), p, lcut_ts_t, link);
+    p->test = test;
+    test->suites++;
+    test->cases += p->ran;
+}
+
+int lcut_tc_add(lcut_ts_t *ts,
+               const char *title,
+               tc_func func,
+               void *para,
+               fixture_func before,
+               fixture_func after) {
+    return lcut_tc_add_timeout(ts, title, func, para, before, after, 0);
+}
+
+/*
+ * tc and title outlive the suite, they live in its arena or are static
+ */
+static void tc_link(lcut_ts_t *ts, lcut_tc_t *tc, const char *title, tc_func func, void *para,
+                    fixture_func before, fixture_func after, int timeout_ms) {
+    memset(tc, 0, sizeof(lcut_tc_t));
+
+    tc->desc = title;
+    tc->func = func;
+    tc->para = para;
+    tc->before = before;
+    tc->after = after;
+    tc->timeout_ms = timeout_ms;
+    APR_RING_ELEM_INIT(tc, link);
+    APR_RING_INSERT_TAIL(&(ts->tc_head), tc, lcut_tc_t, link);
+    ts->ran++;
+
+    /* the suite may have been added to the test already */
+    if (ts->test != NULL) {
+        ts->test->cases++;
+    }
+}
+
+int lcut_tc_add_timeout(lcut_ts_t *ts,
+                        const char *title,
+                        tc_func func,
+                        void *para,
+                        fixture_func before,
+                        fixture_func after,
+                        int timeout_ms) {
+    int	rv	= 0;
+    lcut_tc_t	*tc 	= NULL;
+
+    tc = arena_alloc(&(ts->arena), sizeof(lcut_tc_t));
+    if (tc == NULL || (title = arena_strdup(&(ts->arena), title)) == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d] n", rv);
+        return rv;
+    }
+    tc_link(ts, tc, title, func, para, before, after, timeout_ms);
+
+    return rv;
+}
+
+/*
+ * the rows live in the arena of the suite with the case, the case counts
+ * as its rows. a row of neither table nor gen gets the para of the case
+ */
+static int tc_add_rows(lcut_ts_t *ts, const char *title, tc_func func, void *para,
+                       const void *table, size_t stride, lcut_row_func gen, void *data, int count,
+                       fixture_func before, fixture_func after) {
+    int         rv      = 0;
+    lcut_rows_t *rows   = NULL;
+    lcut_tc_t   *tc     = NULL;
+
+    if (count < 0 || (gen != NULL && stride > LCUT_MAX_ROW)) {
+        return EINVAL;
+    }
+
+    if ((rows = arena_alloc(&(ts->arena), sizeof(lcut_rows_t))) == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", rv);
+        return rv;
+    }
+    if ((rv = lcut_tc_add_timeout(ts, title, func, para, before, after, 0)) != 0) {
+        return rv;
+    }
+
+    tc = APR_RING_LAST(&(ts->tc_head));
+    rows->table  = table;
+    rows->stride = stride;
+    rows->count  = count;
+    rows->gen    = gen;
+    rows->data   = data;
+    rows->tc     = tc;
+    tc->rows     = rows;
+
+    ts->ran += count - 1;
+    if (ts->test != NULL) {
+        ts->test->cases += count - 1;
+    }
+
+    return rv;
+}
+
+int lcut_tc_add_rows(lcut_ts_t *ts, const char *title, tc_func func, const void *table, size_t stride,
+                     int count, fixture_func before, fixture_func after) {
+    if (table == NULL) {
+        return EINVAL;
+    }
+    return tc_add_rows(ts, title, func, NULL, table, stride, NULL, NULL, count, before, after);
+}
+
+int lcut_tc_add_gen(lcut_ts_t *ts, const char *title, tc_func func, lcut_row_func gen, void *data,
+                    size_t size, int count, fixture_func before, fixture_func after) {
+    if (gen == NULL) {
+        return EINVAL;
+    }
+    return tc_add_rows(ts, title, func, NULL, NULL, size, gen, data, count, before, after);
+}
+
+/*
+ * a property case of more than one part is a parameterized case of
+ * neither table nor generator, its rows are the parts
+ */
+int lcut_prop_add(lcut_ts_t *ts, const char *title, tc_func func, void *para, int iterations,
+                  fixture_func before, fixture_func after) {
+    int         rv      = 0;
+    int         parts;
+    lcut_prop_t *prop   = NULL;
+
+    if (iterations < 0) {
+        return EINVAL;
+    }
+    if (iterations == 0) {
+        iterations = LCUT_PROP_PART;
+    }
+    parts = iterations / LCUT_PROP_PART + (iterations % LCUT_PROP_PART != 0);
+
+    if ((prop = arena_alloc(&(ts->arena), sizeof(lcut_prop_t))) == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", rv);
+        return rv;
+    }
+    prop->iterations = iterations;
+    prop->part       = LCUT_PROP_PART;
+
+    if (parts > 1) {
+        rv = tc_add_rows(ts, title, func, para, NULL, 0, NULL, NULL, parts, before, after);
+    } else {
+        rv = lcut_tc_add_timeout(ts, title, func, para, before, after, 0);
+    }
+    if (rv != 0) {
+        return rv;
+    }
+    APR_RING_LAST(&(ts->tc_head))->prop = prop;
+
+    return rv;
+}
+
+const char* lcut_basename(const char *path) {
+    const char  *p  = NULL;
+
+    if (path == NULL) {
+        return "";
+    }
+    p = strrchr(path, '/');
+
+    return p != NULL ? p + 1 : path;
+}
+
+static int case_record_cmp(const void *a, const void *b) {
+    const lcut_case_t   *x  = a;
+    const lcut_case_t   *y  = b;
+    int                 c   = strcmp(x->file, y->file);
+
+    if (c != 0) {
+        return c;
+    }
+
+    return x->line < y->line ? -1 : x->line > y->line;
+}
+
+/*
+ * the suites are made on the first case of each, the cases are linked
+ * in from their static storage. a suite made here takes the cases of
+ * its title which come later, wherever they are defined.
+ */
+int lcut_test_add_cases(lcut_test_t *test, lcut_case_t *cases, lcut_case_t *cases_end,
+                        const lcut_suite_t *suites, const lcut_suite_t *suites_end) {
+    lcut_ts_t           *mark   = APR_RING_LAST(&(test->ts_head));
+    lcut_ts_t           *ts     = NULL;
+    const lcut_suite_t  *s      = NULL;
+    lcut_case_t         *c      = NULL;
+    int                 sorted  = 1;
+    int                 rv      = 0;
+
+    if (cases == NULL || cases_end <= cases) {
+        return 0;
+    }
+
+    /* the linker keeps the order of the objects, not always of the definitions */
+    for (c = cases + 1; c < cases_end && sorted; c++) {
+        sorted = case_record_cmp(c - 1, c) <= 0;
+    }
+    if (!sorted) {
+        qsort(cases, cases_end - cases, sizeof(*cases), case_record_cmp);
+    }
+
+    for (c = cases; c < cases_end; c++) {
+        if (ts != NULL && !strcmp(ts->desc, c->suite)) {
+            tc_link(ts, c->tc, c->name, c->func, NULL, NULL, NULL, 0);
+            continue;
+        }
+
+        for (ts = APR_RING_NEXT(mark, link);
+             ts != APR_RING_SENTINEL(&(test->ts_head), lcut_ts_t, link) && strcmp(ts->desc, c->suite);
+             ts = APR_RING_NEXT(ts, link)) {
+            ;
+        }
+
+        if (ts == APR_RING_SENTINEL(&(test->ts_head), lcut_ts_t, link)) {
+            for (s = suites; s != NULL && s < suites_end && strcmp(s->name, c->suite); s++) {
+                ;
+            }
+            if (s != NULL && s >= suites_end) {
+                s = NULL;
+            }
+            if ((rv = lcut_ts_init(&ts, c->suite, s ? s->setup : NULL, s ? s->teardown : NULL)) != 0) {
+                return rv;
+            }
+            lcut_ts_add(test, ts);
+        }
+
+        tc_link(ts, c->tc, c->name, c->func, NULL, NULL, NULL, 0);
+    }
+
+    return rv;
+}
+
+volatile double lcut_bench_sink;
+
+int lcut_bench_add(lcut_ts_t *ts,
+                   const char *title,
+                   tc_func func,
+                   void *para,
+                   fixture_func before,
+                   fixture_func after) {
+    int             rv      = 0;
+    lcut_bench_t    *bench  = NULL;
+
+    if ((rv = lcut_tc_add_timeout(ts, title, func, para, before, after, 0)) != 0) {
+        return rv;
+    }
+
+    bench = arena_alloc(&(ts->arena), sizeof(lcut_bench_t));
+    if (bench == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", rv);
+        return rv;
+    }
+    memset(bench, 0, sizeof(lcut_bench_t));
+    APR_RING_LAST(&(ts->tc_head))->bench = bench;
+
+    return rv;
+}
+
+int lcut_bench_ab_add(lcut_ts_t *ts,
+                      const char *title,
+                      tc_func fa,
+                      tc_func fb,
+                      void *para,
+                      fixture_func before,
+                      fixture_func after,
+                      int margin) {
+    int rv;
+
+    if ((rv = lcut_bench_add(ts, title, fa, para, before, after)) != 0) {
+        return rv;
+    }
+    APR_RING_LAST(&(ts->tc_head))->bench->func_b = fb;
+    APR_RING_LAST(&(ts->tc_head))->bench->margin = margin;
+
+    return rv;
+}
+
+static int parse_int(const char *str, int *value) {
+    char    *end    = NULL;
+    long    v;
+
+    if (str == NULL || *str == '\0') {
+        return EINVAL;
+    }
+
+    errno = 0;
+    v = strtol(str, &end, 10);
+    if (errno != 0 || *end != '\0' || v < 0 || v > 0x7fffffff) {
+        return EINVAL;
+    }
+
+    (*value) = (int)v;
+    return 0;
+}
+
+/*
+ * decimal, as the failed property cases report it, or 0x hex
+ */
+static int parse_seed(const char *str, unsigned long long *seed) {
+    char                *end    = NULL;
+    unsigned long long  v;
+
+    if (str == NULL || *str == '\0' || *str == '-') {
+        return EINVAL;
+    }
+
+    errno = 0;
+    v = strtoull(str, &end, 0);
+    if (errno != 0 || *end != '\0') {
+        return EINVAL;
+    }
+
+    (*seed) = v;
+    return 0;
+}
+
+/*
+ * match "--name=value" or "--name value", return the value or NULL
+ */
+static const char* option_value(const char *name, int argc, char **argv, int *i) {
+    size_t  len = strlen(name);
+
+    if (strncmp(argv[*i], name, len)) {
+        return NULL;
+    }
+
+    if (argv[*i][len] == '=') {
+        return argv[*i] + len + 1;
+    }
+
+    if (argv[*i][len] == '\0' && (*i) + 1 < argc) {
+        return argv[++(*i)];
+    }
+
+    return NULL;
+}
+
+static int parse_runner(const char *str, int *runner) {
+    if (!strcmp(str, "fork")) {
+        (*runner) = LCUT_RUNNER_FORK;
+    } else if (!strcmp(str, "thread")) {
+        (*runner) = LCUT_RUNNER_THREAD;
+    } else {
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+static int parse_shard_mode(const char *str, int *mode) {
+    if (!strcmp(str, "hash")) {
+        (*mode) = LCUT_SHARD_HASH;
+    } else if (!strcmp(str, "duration")) {
+        (*mode) = LCUT_SHARD_DURATION;
+    } else {
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+/*
+ * "I/N", the shard I of N shards, I counts from 0
+ */
+static int parse_shard(const char *str, int *index, int *count) {
+    char    buf[32];
+    char    *slash  = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", str);
+    if ((slash = strchr(buf, '/')) == NULL) {
+        return EINVAL;
+    }
+    (*slash) = '\0';
+
+    if (parse_int(buf, index) != 0 || parse_int(slash + 1, count) != 0) {
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+static int test_env(lcut_test_t *test) {
+    const char  *v  = NULL;
+
+    if ((v = getenv("LCUT_JOBS")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->jobs) != 0) {
+            printf("\t[LCUT]: invalid LCUT_JOBS <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_TIMINGS")) != NULL && *v != '\0') {
+        test->timings = v;
+    }
+
+    if ((v = getenv("LCUT_TIMEOUT")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->timeout_ms) != 0) {
+            printf("\t[LCUT]: invalid LCUT_TIMEOUT <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_SLOW")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->slow_ms) != 0) {
+            printf("\t[LCUT]: invalid LCUT_SLOW <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_SHARD_COUNT")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->shard_count) != 0) {
+            printf("\t[LCUT]: invalid LCUT_SHARD_COUNT <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_SHARD_INDEX")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->shard_index) != 0) {
+            printf("\t[LCUT]: invalid LCUT_SHARD_INDEX <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_SHARD_MODE")) != NULL && *v != '\0') {
+        if (parse_shard_mode(v, &test->shard_mode) != 0) {
+            printf("\t[LCUT]: invalid LCUT_SHARD_MODE <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_BENCH_SAMPLES")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->bench_samples) != 0 || test->bench_samples == 0) {
+            printf("\t[LCUT]: invalid LCUT_BENCH_SAMPLES <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_BENCH_OUT")) != NULL && *v != '\0') {
+        test->bench_out = v;
+    }
+
+    if ((v = getenv("LCUT_BASELINE")) != NULL && *v != '\0') {
+        test->baseline = v;
+    }
+
+    if ((v = getenv("LCUT_MAX_REGRESSION")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->max_regression) != 0) {
+            printf("\t[LCUT]: invalid LCUT_MAX_REGRESSION <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_PERF")) != NULL && *v != '\0') {
+        test->perf = strcmp(v, "0") != 0;
+    }
+
+    if ((v = getenv("LCUT_TOP")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->top) != 0) {
+            printf("\t[LCUT]: invalid LCUT_TOP <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_HISTORY")) != NULL && *v != '\0') {
+        test->history = v;
+    }
+
+    if ((v = getenv("LCUT_MAX_FAILURES")) != NULL && *v != '\0') {
+        if (parse_int(v, &test->max_failures) != 0) {
+            printf("\t[LCUT]: invalid LCUT_MAX_FAILURES <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_FILTER")) != NULL && *v != '\0') {
+        test->filter = v;
+    }
+
+    if ((v = getenv("LCUT_SEED")) != NULL && *v != '\0') {
+        if (parse_seed(v, &test->seed) != 0) {
+            printf("\t[LCUT]: invalid LCUT_SEED <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if ((v = getenv("LCUT_RESULTS")) != NULL && *v != '\0') {
+        test->results = v;
+    }
+
+    if ((v = getenv("LCUT_QUIET")) != NULL && *v != '\0') {
+        test->quiet = strcmp(v, "0") != 0;
+    }
+
+    if ((v = getenv("LCUT_JUNIT")) != NULL && *v != '\0') {
+        test->junit = v;
+    }
+
+    if ((v = getenv("LCUT_TAP")) != NULL && *v != '\0') {
+        test->tap = v;
+    }
+
+    if ((v = getenv("LCUT_JSON")) != NULL && *v != '\0') {
+        test->json = v;
+    }
+
+    if ((v = getenv("LCUT_RUNNER")) != NULL && *v != '\0') {
+        if (parse_runner(v, &test->runner) != 0) {
+            printf("\t[LCUT]: invalid LCUT_RUNNER <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if (test->shard_count > 0 && test->shard_index >= test->shard_count) {
+        printf("\t[LCUT]: invalid shard %d/%d\n", test->shard_index, test->shard_count);
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+static int test_add_merge(lcut_test_t *test, const char *path) {
+    const char  **merge = NULL;
+
+    merge = realloc(test->merge, (test->nmerge + 1) * sizeof(const char*));
+    if (merge == NULL) {
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        return ENOMEM;
+    }
+
+    merge[test->nmerge++] = path;
+    test->merge = merge;
+
+    return 0;
+}
+
+int lcut_test_args(lcut_test_t *test, int argc, char **argv) {
+    int         i;
+    int         rv;
+    const char  *v  = NULL;
+
+    for (i = 1; i < argc; i++) {
+        if ((v = option_value("--timings", argc, argv, &i)) != NULL) {
+            test->timings = v;
+            continue;
+        }
+
+        if ((v = option_value("--timeout", argc, argv, &i)) != NULL) {
+            if (parse_int(v, &test->timeout_ms) != 0) {
+                printf("\t[LCUT]: invalid timeout <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--slow", argc, argv, &i)) != NULL) {
+            if (parse_int(v, &test->slow_ms) != 0) {
+                printf("\t[LCUT]: invalid slow threshold <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--shard", argc, argv, &i)) != NULL) {
+            if (parse_shard(v, &test->shard_index, &test->shard_count) != 0) {
+                printf("\t[LCUT]: invalid shard <%s>, I/N expected\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--shard-mode", argc, argv, &i)) != NULL) {
+            if (parse_shard_mode(v, &test->shard_mode) != 0) {
+                printf("\t[LCUT]: invalid shard mode <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--filter", argc, argv, &i)) != NULL) {
+            test->filter = v;
+            continue;
+        }
+
+        if ((v = option_value("--history", argc, argv, &i)) != NULL) {
+            test->history = v;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--fail-fast")) {
+            test->max_failures = 1;
+            continue;
+        }
+
+        if ((v = option_value("--max-failures", argc, argv, &i)) != NULL) {
+            if (parse_int(v, &test->max_failures) != 0) {
+                printf("\t[LCUT]: invalid max failures <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--bench-samples", argc, argv, &i)) != NULL) {
+            if (parse_int(v, &test->bench_samples) != 0 || test->bench_samples == 0) {
+                printf("\t[LCUT]: invalid bench samples <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--bench-out", argc, argv, &i)) != NULL) {
+            test->bench_out = v;
+            continue;
+        }
+
+        if ((v = option_value("--baseline", argc, argv, &i)) != NULL) {
+            test->baseline = v;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--save-baseline")) {
+            test->save_baseline = 1;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--perf")) {
+            test->perf = 1;
+            continue;
+        }
+
+        if ((v = option_value("--max-regression", argc, argv, &i)) != NULL) {
+            if (parse_int(v, &test->max_regression) != 0) {
+                printf("\t[LCUT]: invalid max regression <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--top", argc, argv, &i)) != NULL) {
+            if (parse_int(v, &test->top) != 0) {
+                printf("\t[LCUT]: invalid top count <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--list")) {
+            test->list = 1;
+            continue;
+        }
+
+        if ((v = option_value("--results", argc, argv, &i)) != NULL) {
+            test->results = v;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--quiet")) {
+            test->quiet = 1;
+            continue;
+        }
+
+        if ((v = option_value("--junit", argc, argv, &i)) != NULL) {
+            test->junit = v;
+            continue;
+        }
+
+        if ((v = option_value("--tap", argc, argv, &i)) != NULL) {
+            test->tap = v;
+            continue;
+        }
+
+        if ((v = option_value("--json", argc, argv, &i)) != NULL) {
+            test->json = v;
+            continue;
+        }
+
+        if ((v = option_value("--seed", argc, argv, &i)) != NULL) {
+            if (parse_seed(v, &test->seed) != 0) {
+                printf("\t[LCUT]: invalid seed <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--merge", argc, argv, &i)) != NULL) {
+            if ((rv = test_add_merge(test, v)) != 0) {
+                return rv;
+            }
+            continue;
+        }
+
+        if ((v = option_value("--runner", argc, argv, &i)) != NULL) {
+            if (parse_runner(v, &test->runner) != 0) {
+                printf("\t[LCUT]: invalid runner <%s>\n", v);
+                return EINVAL;
+            }
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            v = argv[++i];
+        } else if (!strncmp(argv[i], "-j", 2) && argv[i][2] != '\0') {
+            v = argv[i] + 2;
+        } else if ((v = option_value("--jobs", argc, argv, &i)) == NULL) {
+            printf("\t[LCUT]: unknown option <%s>\n", argv[i]);
+            return EINVAL;
+        }
+
+        if (parse_int(v, &test->jobs) != 0) {
+            printf("\t[LCUT]: invalid jobs count <%s>\n", v);
+            return EINVAL;
+        }
+    }
+
+    if (test->shard_count > 0 && test->shard_index >= test->shard_count) {
+        printf("\t[LCUT]: invalid shard %d/%d\n", test->shard_index, test->shard_count);
+        return EINVAL;
+    }
+
+    if (test->save_baseline && test->baseline == NULL) {
+        printf("\t[LCUT]: --save-baseline needs --baseline=FILE\n");
+        return EINVAL;
+    }
+
+    return 0;
+}
+
+static unsigned long long hash_str(unsigned long long h, const char *str) {
+    while (*str) {
+        h ^= (unsigned char)(*str++);
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+static unsigned long long hash_mix(unsigned long long h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h ? h : 1;
+}
+
+/*
+ * xoshiro256** seeded by splitmix64, for the statistics which resample
+ */
+typedef struct lcut_rng_t {
+    unsigned long long          s[4];
+} lcut_rng_t;
+
+static unsigned long long rng_rotl(unsigned long long x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static void rng_seed(lcut_rng_t *rng, unsigned long long seed) {
+    unsigned long long  z;
+    int                 i;
+
+    for (i = 0; i < 4; i++) {
+        z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+static unsigned long long rng_next(lcut_rng_t *rng) {
+    unsigned long long  *s      = rng->s;
+    unsigned long long  result  = rng_rotl(s[1] * 5, 7) * 9;
+    unsigned long long  t       = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3]  = rng_rotl(s[3], 45);
+
+    return result;
+}
+
+/*
+ * uniform in [0, n)
+ */
+static unsigned long long rng_below(lcut_rng_t *rng, unsigned long long n) {
+    return n > 0 ? rng_next(rng) % n : 0;
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * the cpu time of the calling thread, the case runs on a single thread
+ */
+static long long cpu_ns(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int timings_init(lcut_timings_t *t, size_t hint) {
+    t->cap   = 64;
+    t->count = 0;
+    while (t->cap < hint * 2) {
+        t->cap <<= 1;
+    }
+
+    t->slots = calloc(t->cap, sizeof(lcut_timing_t));
+    return t->slots == NULL ? ENOMEM : 0;
+}
+
+static lcut_timing_t* timings_slot(lcut_timings_t *t, unsigned long long key) {
+    size_t  i = key & (t->cap - 1);
+
+    while (t->slots[i].key != 0 && t->slots[i].key != key) {
+        i = (i + 1) & (t->cap - 1);
+    }
+
+    return &(t->slots[i]);
+}
+
+static lcut_timing_t* timings_put(lcut_timings_t *t, unsigned long long key) {
+    lcut_timing_t   *slot   = NULL;
+    lcut_timing_t   *old    = t->slots;
+    size_t          cap     = t->cap;
+    size_t          i;
+
+    if ((t->count + 1) * 2 > t->cap) {
+        t->slots = calloc(cap * 2, sizeof(lcut_timing_t));
+        if (t->slots == NULL) {
+            t->slots = old;
+            return NULL;
+        }
+        t->cap = cap * 2;
+        for (i = 0; i < cap; i++) {
+            if (old[i].key != 0) {
+                (*timings_slot(t, old[i].key)) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    slot = timings_slot(t, key);
+    if (slot->key == 0) {
+        slot->key = key;
+        t->count++;
+    }
+
+    return slot;
+}
+
+/*
+ * the timings file has a header line and then one "key ns suite/case" line per case
+ */
+static void timings_load(lcut_timings_t *t, const char *path) {
+    FILE                *fp     = NULL;
+    char                line[512];
+    unsigned long long  key;
+    long long           ns;
+    lcut_timing_t       *slot   = NULL;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        return;
+    }
+
+    if (fgets(line, sizeof(line), fp) == NULL || strncmp(line, "lcut-timings 1", 14)) {
+        fclose(fp);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "%llx %lld", &key, &ns) == 2 && key != 0
+            && (slot = timings_put(t, key)) != NULL) {
+            slot->ns = ns;
+        }
+    }
+
+    fclose(fp);
+}
+
+static void timings_save(lcut_timings_t *t, const char *path) {
+    FILE    *fp     = NULL;
+    char    tmp[4096];
+    size_t  i;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    if ((fp = fopen(tmp, "w")) == NULL) {
+        printf("\t[LCUT]: can't write the timings file <%s>, errcode[%d]\n", tmp, errno);
+        return;
+    }
+
+    fprintf(fp, "lcut-timings 1\n");
+    for (i = 0; i < t->cap; i++) {
+        if (t->slots[i].key == 0) {
+            continue;
+        }
+        fprintf(fp, "%016llx %lld", t->slots[i].key, t->slots[i].ns);
+        if (t->slots[i].tc_desc != NULL) {
+            fprintf(fp, " %s/%s", t->slots[i].ts_desc, t->slots[i].tc_desc);
+        }
+        if (t->slots[i].tc_desc != NULL && t->slots[i].row >= 0) {
+            fprintf(fp, "/%d", t->slots[i].row);
+        }
+        fprintf(fp, "\n");
+    }
+
+    if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+        printf("\t[LCUT]: can't write the timings file <%s>, errcode[%d]\n", path, errno);
+        unlink(tmp);
+    }
+}
+
+/*
+ * estimate the cases with the durations of the last run,
+ * then remember the durations of this run
+ */
+static void plan_load_timings(lcut_plan_t *plan, const char *path, lcut_timings_t *t) {
+    lcut_timing_t   *slot   = NULL;
+    int             i;
+
+    if (timings_init(t, plan->ncases) != 0) {
+        return;
+    }
+
+    timings_load(t, path);
+
+    for (i = 0; i < plan->ncases; i++) {
+        slot = timings_slot(t, plan->cases[i].key);
+        if (slot->key != 0) {
+            plan->cases[i].est_ns = slot->ns;
+            plan->nestimated++;
+        }
+    }
+}
+
+static void plan_save_timings(lcut_plan_t *plan, const char *path, lcut_timings_t *t) {
+    lcut_timing_t   *slot   = NULL;
+    int             i;
+
+    if (t->slots == NULL) {
+        return;
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        if (!plan->cases[i].done || plan->cases[i].skipped
+            || (slot = timings_put(t, plan->cases[i].key)) == NULL) {
+            continue;
+        }
+        slot->ns      = plan->cases[i].elapsed_ns;
+        slot->ts_desc = plan->suites[plan->cases[i].suite].ts->desc;
+        slot->tc_desc = plan->cases[i].tc->desc;
+        slot->row     = plan->cases[i].row;
+    }
+
+    timings_save(t, path);
+    free(t->slots);
+    t->slots = NULL;
+}
+
+static int history_map(lcut_history_t *h, int fd, unsigned int cap, int init) {
+    size_t  size = sizeof(lcut_history_hdr_t) + cap * sizeof(lcut_history_rec_t);
+    void    *p   = NULL;
+
+    if (init && ftruncate(fd, size) != 0) {
+        return errno;
+    }
+
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        return errno;
+    }
+
+    h->fd   = fd;
+    h->size = size;
+    h->hdr  = p;
+    h->recs = (lcut_history_rec_t*)(h->hdr + 1);
+    if (init) {
+        memcpy(h->hdr->magic, LCUT_HISTORY_MAGIC, sizeof(h->hdr->magic));
+        h->hdr->cap   = cap;
+        h->hdr->count = 0;
+    }
+
+    return 0;
+}
+
+static void history_close(lcut_history_t *h) {
+    if (h->hdr != NULL) {
+        munmap(h->hdr, h->size);
+        close(h->fd);
+    }
+    memset(h, 0, sizeof(*h));
+}
+
+static lcut_history_rec_t* history_slot(lcut_history_t *h, unsigned long long key) {
+    unsigned int    i = (unsigned int)key & (h->hdr->cap - 1);
+
+    while (h->recs[i].key != 0 && h->recs[i].key != key) {
+        i = (i + 1) & (h->hdr->cap - 1);
+    }
+
+    return &(h->recs[i]);
+}
+
+/*
+ * move the history into a bigger table, which replaces the file
+ */
+static int history_grow(lcut_history_t *h, const char *path, unsigned int cap) {
+    lcut_history_t  bigger;
+    char            tmp[4096];
+    unsigned int    i;
+    int             fd, rv;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        return errno;
+    }
+
+    /* the runs waiting for the lock of path find the new file locked */
+    rv = (flock(fd, LOCK_EX) != 0) ? errno : history_map(&bigger, fd, cap, 1);
+    if (rv != 0) {
+        close(fd);
+        unlink(tmp);
+        return rv;
+    }
+
+    for (i = 0; i < h->hdr->cap; i++) {
+        if (h->recs[i].key != 0) {
+            (*history_slot(&bigger, h->recs[i].key)) = h->recs[i];
+            bigger.hdr->count++;
+        }
+    }
+
+    if (rename(tmp, path) != 0) {
+        rv = errno;
+        history_close(&bigger);
+        unlink(tmp);
+        return rv;
+    }
+
+    history_close(h);
+    (*h) = bigger;
+
+    return 0;
+}
+
+/*
+ * map and lock the history file, with room for the cases of this run.
+ * a file which is not empty and not a history is refused with EINVAL
+ */
+static int history_open(lcut_history_t *h, const char *path, unsigned int ncases) {
+    lcut_history_hdr_t  hdr;
+    struct stat         st, cur;
+    unsigned int        cap = 64;
+    int                 fd, rv;
+
+    memset(h, 0, sizeof(*h));
+    for (;;) {
+        if ((fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+            return errno;
+        }
+        if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) {
+            rv = errno;
+            close(fd);
+            return rv;
+        }
+        /* a grow of another run may have replaced the file while we waited */
+        if (stat(path, &cur) == 0 && cur.st_dev == st.st_dev && cur.st_ino == st.st_ino) {
+            break;
+        }
+        close(fd);
+    }
+
+    if (st.st_size == 0) {
+        while (cap < ncases * 2) {
+            cap <<= 1;
+        }
+        rv = history_map(h, fd, cap, 1);
+    } else if ((size_t)st.st_size >= sizeof(hdr)
+        && pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)
+        && !memcmp(hdr.magic, LCUT_HISTORY_MAGIC, sizeof(hdr.magic))
+        && hdr.cap > 0 && (hdr.cap & (hdr.cap - 1)) == 0
+        && (size_t)st.st_size == sizeof(hdr) + hdr.cap * sizeof(lcut_history_rec_t)) {
+        rv = history_map(h, fd, hdr.cap, 0);
+    } else {
+        rv = EINVAL;
+    }
+
+    if (rv != 0) {
+        close(fd);
+        return rv;
+    }
+
+    if ((h->hdr->count + ncases) * 2 > h->hdr->cap) {
+        cap = h->hdr->cap;
+        while ((h->hdr->count + ncases) * 2 > cap) {
+            cap <<= 1;
+        }
+        if ((rv = history_grow(h, path, cap)) != 0) {
+            history_close(h);
+            return rv;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * a case flipping between pass and fail again and again is flaky
+ */
+static int history_flaky(unsigned int outcomes, unsigned int runs) {
+    unsigned int    window  = runs < LCUT_HISTORY_WINDOW ? runs : LCUT_HISTORY_WINDOW;
+    unsigned int    flips   = 0;
+    unsigned int    i;
+
+    for (i = 1; i < window; i++) {
+        flips += ((outcomes >> i) ^ (outcomes >> (i - 1))) & 1;
+    }
+
+    return flips >= LCUT_HISTORY_FLIPS;
+}
+
+/*
+ * put the cases failed in the last run first, and their suites first
+ */
+static void plan_failed_first(lcut_plan_t *plan) {
+    lcut_plan_ts_t  *suites = NULL;
+    lcut_plan_tc_t  *cases  = NULL;
+    lcut_plan_ts_t  *s      = NULL;
+    int             *failed = NULL;
+    int             nsuites = 0;
+    int             ncases  = 0;
+    int             pass, i, j, k;
+
+    suites = calloc(plan->nsuites + 1, sizeof(lcut_plan_ts_t));
+    cases  = calloc(plan->ncases + 1, sizeof(lcut_plan_tc_t));
+    failed = calloc(plan->nsuites + 1, sizeof(int));
+    if (suites == NULL || cases == NULL || failed == NULL) {
+        free(suites);
+        free(cases);
+        free(failed);
+        return;
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        if (plan->cases[i].runs > 0 && (plan->cases[i].history & 1)) {
+            failed[plan->cases[i].suite]++;
+        }
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < plan->nsuites; i++) {
+            if ((failed[i] > 0) != (pass == 0)) {
+                continue;
+            }
+
+            s = &(plan->suites[i]);
+            suites[nsuites]       = (*s);
+            suites[nsuites].first = ncases;
+            for (k = 0; k < 2; k++) {
+                for (j = s->first; j < s->first + s->count; j++) {
+                    if ((plan->cases[j].runs > 0 && (plan->cases[j].history & 1)) == (k == 0)) {
+                        cases[ncases] = plan->cases[j];
+                        cases[ncases++].suite = nsuites;
+                    }
+                }
+            }
+            nsuites++;
+        }
+    }
+
+    free(plan->suites);
+    free(plan->cases);
+    free(failed);
+    plan->suites = suites;
+    plan->cases  = cases;
+}
+
+static int plan_open_history(lcut_plan_t *plan, const char *path, lcut_history_t *h) {
+    int     rv;
+
+    if ((rv = history_open(h, path, plan->ncases)) == EINVAL) {
+        printf("\t[LCUT]: <%s> is not a history file, left as it is\n", path);
+    } else if (rv != 0) {
+        printf("\t[LCUT]: can't map the history file <%s>, errcode[%d]\n", path, rv);
+    }
+
+    return rv;
+}
+
+static int plan_load_history(lcut_plan_t *plan, const char *path) {
+    lcut_history_t      h;
+    lcut_history_rec_t  *rec    = NULL;
+    int                 i;
+
+    if (plan_open_history(plan, path, &h) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        rec = history_slot(&h, plan->cases[i].key);
+        if (rec->key != 0) {
+            plan->cases[i].history = rec->outcomes;
+            plan->cases[i].runs    = rec->runs;
+        }
+    }
+    history_close(&h);
+
+    plan_failed_first(plan);
+    return 0;
+}
+
+/*
+ * the file is mapped again, the other runs sharing it may have grown it
+ */
+static void plan_save_history(lcut_plan_t *plan, const char *path) {
+    lcut_history_t      h;
+    lcut_history_rec_t  *rec    = NULL;
+    lcut_plan_tc_t      *c      = NULL;
+    int                 i;
+
+    if (plan_open_history(plan, path, &h) != 0) {
+        return;
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        c = &(plan->cases[i]);
+        if (!c->done || c->skipped) {
+            continue;
+        }
+
+        rec = history_slot(&h, c->key);
+        if (rec->key == 0) {
+            rec->key = c->key;
+            h.hdr->count++;
+        }
+        rec->ns       = c->elapsed_ns;
+        rec->outcomes = (rec->outcomes << 1) | c->failed;
+        if (rec->runs < 0xffffffffU) {
+            rec->runs++;
+        }
+    }
+
+    history_close(&h);
+}
+
+typedef struct lcut_sched_item_t {
+    int                         idx;
+    int                         first;      /* 1: failed in the last run */
+    long long                   est_ns;
+} lcut_sched_item_t;
+
+static int sched_item_cmp(const void *a, const void *b) {
+    const lcut_sched_item_t *x = a;
+    const lcut_sched_item_t *y = b;
+
+    if (x->first != y->first) {
+        return y->first - x->first;
+    }
+
+    if (x->est_ns != y->est_ns) {
+        return x->est_ns < y->est_ns ? 1 : -1;
+    }
+
+    return x->idx - y->idx;
+}
+
+static int plan_build(lcut_test_t *test, lcut_plan_t *plan) {
+    lcut_ts_t       *ts = NULL;
+    lcut_tc_t       *tc = NULL;
+    int             nsuites = 0;
+    int             ncases  = 0;
+    lcut_timings_t  seen;
+    lcut_timing_t   *slot   = NULL;
+    lcut_plan_tc_t  *c      = NULL;
+    unsigned long long h;
+    int             row, rows;
+
+    memset(plan, 0, sizeof(*plan));
+
+    APR_RING_FOREACH(ts, &(test->ts_head), lcut_ts_t, link) {
+        nsuites++;
+        ncases += ts->ran;
+    }
+
+    plan->suites = calloc(nsuites + 1, sizeof(lcut_plan_ts_t));
+    plan->cases  = calloc(ncases + 1, sizeof(lcut_plan_tc_t));
+    if (plan->suites == NULL || plan->cases == NULL || timings_init(&seen, ncases) != 0) {
+        free(plan->suites);
+        free(plan->cases);
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        return ENOMEM;
+    }
+
+    APR_RING_FOREACH(ts, &(test->ts_head), lcut_ts_t, link) {
+        plan->suites[plan->nsuites].ts    = ts;
+        plan->suites[plan->nsuites].first = plan->ncases;
+        APR_RING_FOREACH(tc, &(ts->tc_head), lcut_tc_t, link) {
+            /* the same suite/case pair may be added more than once */
+            h = hash_mix(hash_str(hash_str(0xcbf29ce484222325ULL, ts->desc) ^ '/', tc->desc));
+            slot = timings_put(&seen, h);
+            h = hash_mix(h + (slot ? slot->ns++ : 0));
+            if (tc->bench != NULL) {
+                tc->bench->wanted = test->bench_samples;
+            }
+
+            /* a parameterized case takes one entry per row, its case is made by row_open */
+            rows = tc->rows != NULL ? tc->rows->count : 1;
+            for (row = 0; row < rows; row++) {
+                c = &(plan->cases[plan->ncases++]);
+                c->key        = tc->rows != NULL ? hash_mix(h + row + 1) : h;
+                c->tc         = tc;
+                c->row        = tc->rows != NULL ? row : -1;
+                c->suite      = plan->nsuites;
+                c->est_ns     = -1;
+                c->selected   = 1;
+                /* a benchmark runs as long as its samples take, the default timeout is not for it */
+                c->timeout_ms = tc->timeout_ms > 0 ? tc->timeout_ms
+                                : (tc->bench == NULL ? test->timeout_ms : 0);
+            }
+        }
+        plan->suites[plan->nsuites].count = plan->ncases - plan->suites[plan->nsuites].first;
+        plan->nsuites++;
+    }
+
+    free(seen.slots);
+    plan->slow_ms = test->slow_ms;
+    plan->max_failures = test->max_failures;
+    plan->max_regression = test->max_regression;
+
+    return 0;
+}
+
+/*
+ * drop the cases which are not selected, and the suites left without case
+ */
+static void plan_compact(lcut_plan_t *plan) {
+    lcut_plan_ts_t  *s  = NULL;
+    int             nsuites = 0;
+    int             ncases  = 0;
+    int             first, i, j;
+
+    for (i = 0; i < plan->nsuites; i++) {
+        s     = &(plan->suites[i]);
+        first = ncases;
+        for (j = s->first; j < s->first + s->count; j++) {
+            if (plan->cases[j].selected) {
+                plan->cases[ncases] = plan->cases[j];
+                plan->cases[ncases++].suite = nsuites;
+            } else {
+                plan->dropped_cases++;
+            }
+        }
+
+        if (s->count > 0 && ncases == first) {
+            plan->dropped_suites++;
+            continue;
+        }
+
+        plan->suites[nsuites]       = (*s);
+        plan->suites[nsuites].first = first;
+        plan->suites[nsuites].count = ncases - first;
+        nsuites++;
+    }
+
+    plan->nsuites = nsuites;
+    plan->ncases  = ncases;
+}
+
+/*
+ * keep the cases of one shard, either by the hash of suite/case
+ * or dealt longest-first to the least loaded shard
+ */
+static void plan_shard(lcut_plan_t *plan, int index, int count, int mode) {
+    lcut_sched_item_t   *sorted = NULL;
+    long long           *load   = NULL;
+    long long           known   = 0;
+    long long           mean    = 1;
+    int                 i, q, best;
+
+    if (mode == LCUT_SHARD_DURATION) {
+        sorted = calloc(plan->ncases + 1, sizeof(lcut_sched_item_t));
+        load   = calloc(count, sizeof(long long));
+    }
+
+    if (sorted == NULL || load == NULL) {
+        for (i = 0; i < plan->ncases; i++) {
+            plan->cases[i].selected = (int)(plan->cases[i].key % count) == index;
+        }
+        free(sorted);
+        free(load);
+        plan_compact(plan);
+        return;
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        if (plan->cases[i].est_ns >= 0) {
+            known += plan->cases[i].est_ns;
+        }
+    }
+    if (plan->nestimated > 0) {
+        mean = known / plan->nestimated;
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        sorted[i].idx    = i;
+        sorted[i].est_ns = plan->cases[i].est_ns >= 0 ? plan->cases[i].est_ns : mean;
+    }
+    qsort(sorted, plan->ncases, sizeof(lcut_sched_item_t), sched_item_cmp);
+
+    for (i = 0; i < plan->ncases; i++) {
+        best = 0;
+        for (q = 1; q < count; q++) {
+            if (load[q] < load[best]) {
+                best = q;
+            }
+        }
+        load[best] += sorted[i].est_ns;
+        plan->cases[sorted[i].idx].selected = best == index;
+    }
+
+    free(sorted);
+    free(load);
+    plan_compact(plan);
+}
+
+/*
+ * the filter is a ':' separated list of glob patterns over "suite/case",
+ * the patterns starting with '-' exclude the cases they match. a row of
+ * a parameterized case is matched as "suite/case/row" and as its case.
+ */
+static int filter_match(const char *filter, const char *name, const char *parent) {
+    char        pattern[LCUT_MAX_STR_LEN];
+    const char  *p          = filter;
+    const char  *end        = NULL;
+    size_t      len;
+    int         included    = 0;
+    int         includes    = 0;
+
+    while (*p != '\0') {
+        if ((end = strchr(p, ':')) == NULL) {
+            end = p + strlen(p);
+        }
+
+        len = end - p;
+        if (len >= sizeof(pattern)) {
+            len = sizeof(pattern) - 1;
+        }
+        memcpy(pattern, p, len);
+        pattern[len] = '\0';
+
+        if (pattern[0] == '-') {
+            if (fnmatch(pattern + 1, name, 0) == 0 || (parent != NULL && fnmatch(pattern + 1, parent, 0) == 0)) {
+                return 0;
+            }
+        } else if (pattern[0] != '\0') {
+            includes++;
+            if (fnmatch(pattern, name, 0) == 0 || (parent != NULL && fnmatch(pattern, parent, 0) == 0)) {
+                included = 1;
+            }
+        }
+
+        p = (*end == ':') ? end + 1 : end;
+    }
+
+    return includes == 0 || included;
+}
+
+static void plan_filter(lcut_plan_t *plan, const char *filter) {
+    char            name[LCUT_MAX_NAME_LEN * 2 + 2];
+    char            row[LCUT_MAX_NAME_LEN * 2 + 16];
+    lcut_plan_tc_t  *c  = NULL;
+    int             i;
+
+    for (i = 0; i < plan->ncases; i++) {
+        c = &(plan->cases[i]);
+        snprintf(name, sizeof(name), "%s/%s", plan->suites[c->suite].ts->desc, c->tc->desc);
+        if (c->row >= 0) {
+            snprintf(row, sizeof(row), "%s/%d", name, c->row);
+            c->selected = filter_match(filter, row, name);
+        } else {
+            c->selected = filter_match(filter, name, NULL);
+        }
+    }
+
+    plan_compact(plan);
+}
+
+static void plan_list(lcut_plan_t *plan) {
+    lcut_plan_tc_t  *c  = NULL;
+    int             i;
+
+    for (i = 0; i < plan->ncases; i++) {
+        c = &(plan->cases[i]);
+        if (c->row >= 0) {
+            printf("%s/%s/%d\n", plan->suites[c->suite].ts->desc, c->tc->desc, c->row);
+        } else {
+            printf("%s/%s\n", plan->suites[c->suite].ts->desc, c->tc->desc);
+        }
+    }
+}
+
+/*
+ * the cases count their perf events into the plan
+ */
+static int plan_perf(lcut_plan_t *plan) {
+    int i;
+
+    if ((plan->perfs = malloc((plan->ncases + 1) * sizeof(lcut_perf_t))) == NULL) {
+        return ENOMEM;
+    }
+    for (i = 0; i < plan->ncases; i++) {
+        if (plan->cases[i].row < 0) {
+            plan->cases[i].tc->perf = &(plan->perfs[i]);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * a row runs as a case of its own, made from its parameterized case
+ * when it is handed out, its name "case/row" right after it
+ */
+static lcut_tc_t* row_open(lcut_plan_t *plan, lcut_plan_tc_t *c) {
+    lcut_tc_t   *parent = c->tc;
+    lcut_tc_t   *tc     = NULL;
+    const char  *table  = NULL;
+
+    if (c->row < 0 || parent != parent->rows->tc) {
+        return c->tc;
+    }
+
+    if ((tc = calloc(1, sizeof(lcut_tc_t) + strlen(parent->desc) + 12)) == NULL) {
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    table = parent->rows->table;
+    tc->desc   = (char *)(tc + 1);
+    tc->func   = parent->func;
+    tc->para   = table != NULL ? (void *)(table + (size_t)c->row * parent->rows->stride) : parent->para;
+    tc->before = parent->before;
+    tc->after  = parent->after;
+    tc->rows   = parent->rows;
+    tc->row    = c->row;
+    tc->prop   = parent->prop;
+    tc->perf   = plan->perfs != NULL ? &(plan->perfs[c - plan->cases]) : NULL;
+    sprintf((char *)(tc + 1), "%s/%d", parent->desc, c->row);
+    c->tc = tc;
+
+    return tc;
+}
+
+/*
+ * drop the case of a row, summed up into its parameterized case
+ * for the summary of the test unless the row ran in a worker
+ */
+static void row_close(lcut_plan_tc_t *c, int fold) {
+    lcut_tc_t   *tc     = c->tc;
+    lcut_tc_t   *parent = NULL;
+
+    if (c->row < 0 || tc == tc->rows->tc) {
+        return;
+    }
+
+    parent = tc->rows->tc;
+    if (fold) {
+        if (tc->status == TEST_CASE_FAILURE) {
+            parent->status = TEST_CASE_FAILURE;
+        }
+        parent->wall_ns    += tc->wall_ns;
+        parent->cpu_ns     += tc->cpu_ns;
+        parent->fixture_ns += tc->fixture_ns;
+        parent->asserts    += tc->asserts;
+    }
+    failure_free(tc);
+    free(tc);
+    c->tc = parent;
+}
+
+static void plan_destroy(lcut_plan_t *plan) {
+    int i;
+
+    for (i = 0; i < plan->ncases; i++) {
+        row_close(&(plan->cases[i]), 1);
+        if (plan->perfs != NULL) {
+            plan->cases[i].tc->perf = NULL;
+        }
+    }
+    free(plan->perfs);
+    free(plan->suites);
+    free(plan->cases);
+    memset(plan, 0, sizeof(*plan));
+}
+
+#ifdef LCUT_ALLOC_HOOKS
+static size_t block_hash(lcut_tracker_t *t, void *p) {
+    return (size_t)(((unsigned long long)(size_t)p >> 4) * 0x9e3779b97f4a7c15ULL >> 20) & (t->cap - 1);
+}
+
+static lcut_block_t* block_slot(lcut_tracker_t *t, void *p) {
+    size_t  i = block_hash(t, p);
+
+    while (t->blocks[i].p != NULL && t->blocks[i].p != p) {
+        i = (i + 1) & (t->cap - 1);
+    }
+
+    return &(t->blocks[i]);
+}
+
+static int blocks_grow(lcut_tracker_t *t) {
+    lcut_block_t    *old    = t->blocks;
+    size_t          cap     = t->cap;
+    size_t          i;
+    void            *p;
+
+    p = mmap(NULL, (cap ? cap * 2 : 4096) * sizeof(lcut_block_t),
+             PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return ENOMEM;
+    }
+
+    t->blocks = p;
+    t->cap    = cap ? cap * 2 : 4096;
+    for (i = 0; i < cap; i++) {
+        if (old[i].p != NULL) {
+            (*block_slot(t, old[i].p)) = old[i];
+        }
+    }
+    if (old != NULL) {
+        munmap(old, cap * sizeof(lcut_block_t));
+    }
+
+    return 0;
+}
+
+static void block_add(lcut_tracker_t *t, void *p, size_t size) {
+    lcut_block_t    *slot   = NULL;
+
+    t->allocs.count++;
+    t->allocs.bytes += size;
+    if ((t->allocs.leaks + 1) * 2 > (long long)t->cap && blocks_grow(t) != 0) {
+        return;
+    }
+
+    slot       = block_slot(t, p);
+    slot->p    = p;
+    slot->size = size;
+    t->allocs.leaks++;
+    t->live += size;
+    if (t->live > t->allocs.peak) {
+        t->allocs.peak = t->live;
+    }
+}
+
+/*
+ * linear probing, the blocks after the removed one are shifted back
+ */
+static void block_remove(lcut_tracker_t *t, void *p) {
+    lcut_block_t    *slot   = NULL;
+    size_t          i, j, k;
+
+    if (t->cap == 0 || (slot = block_slot(t, p))->p == NULL) {
+        return;
+    }
+
+    t->allocs.leaks--;
+    t->live -= slot->size;
+    slot->p  = NULL;
+
+    i = slot - t->blocks;
+    for (j = (i + 1) & (t->cap - 1); t->blocks[j].p != NULL; j = (j + 1) & (t->cap - 1)) {
+        k = block_hash(t, t->blocks[j].p);
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            t->blocks[i]   = t->blocks[j];
+            t->blocks[j].p = NULL;
+            i = j;
+        }
+    }
+}
+
+void lcut_alloc_hooks(void) {
+    _alloc_hooked = 1;
+}
+
+/*
+ * called by the hooks of liblcut_alloc for every block, on any thread
+ */
+void lcut_alloc_track(void *p, size_t size) {
+    if (_tracker.on && p != NULL) {
+        block_add(&_tracker, p, size);
+    }
+}
+
+void lcut_alloc_untrack(void *p) {
+    if (_tracker.on && p != NULL) {
+        block_remove(&_tracker, p);
+    }
+}
+#endif
+
+static void alloc_begin(void) {
+#ifdef LCUT_ALLOC_HOOKS
+    memset(&(_tracker.allocs), 0, sizeof(_tracker.allocs));
+    _tracker.live = 0;
+    _tracker.on   = 1;
+#endif
+}
+
+/*
+ * stop tracking, and keep what the func allocated
+ */
+static void alloc_end(lcut_allocs_t *allocs) {
+#ifdef LCUT_ALLOC_HOOKS
+    _tracker.on = 0;
+    if (allocs != NULL) {
+        (*allocs)          = _tracker.allocs;
+        allocs->leaked     = _tracker.live;
+    }
+    if (_tracker.allocs.leaks > 0) {
+        memset(_tracker.blocks, 0, _tracker.cap * sizeof(lcut_block_t));
+        _tracker.allocs.leaks = 0;
+    }
+#endif
+}
+
+/*
+ * lcut's own allocations are not the case's
+ */
+static int alloc_pause(void) {
+#ifdef LCUT_ALLOC_HOOKS
+    int on = _tracker.on;
+
+    _tracker.on = 0;
+    return on;
+#else
+    return 0;
+#endif
+}
+
+static void alloc_resume(int on) {
+#ifdef LCUT_ALLOC_HOOKS
+    _tracker.on = on;
+#endif
+}
+
+#ifdef LCUT_PERF_EVENTS
+typedef struct lcut_perf_event_t {
+    unsigned int                type;
+    unsigned long long          config;
+    size_t                      offset;     /* of the count in lcut_perf_t */
+} lcut_perf_event_t;
+
+/* the hardware events first, the software ones stand in for them */
+static const lcut_perf_event_t _perf_events[PERF_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, offsetof(lcut_perf_t, instructions)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, offsetof(lcut_perf_t, cycles)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, offsetof(lcut_perf_t, branch_misses)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), offsetof(lcut_perf_t, l1d_misses)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, offsetof(lcut_perf_t, llc_misses)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, offsetof(lcut_perf_t, task_clock_ns)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, offsetof(lcut_perf_t, page_faults)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, offsetof(lcut_perf_t, context_switches)}
+};
+
+static int perf_open_event(const lcut_perf_event_t *ev) {
+    struct perf_event_attr  attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = ev->type;
+    attr.config         = ev->config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+#endif
+
+static void perf_close(void) {
+    int i;
+
+    for (i = 0; _perf.tid != 0 && i < PERF_EVENTS; i++) {
+        if (_perf.fds[i] >= 0) {
+            close(_perf.fds[i]);
+        }
+    }
+    _perf.tid = 0;
+}
+
+/*
+ * open the counters of the calling thread, unless it has them already,
+ * returns the count of the events counted
+ */
+static int perf_open(void) {
+    int     count   = 0;
+#ifdef LCUT_PERF_EVENTS
+    pid_t   tid     = (pid_t)syscall(SYS_gettid);
+    int     i;
+
+    if (_perf.tid == tid) {
+        for (i = 0; i < PERF_EVENTS; i++) {
+            count += _perf.fds[i] >= 0;
+        }
+        return count;
+    }
+
+    /* the counters of the parent, in a forked worker */
+    perf_close();
+
+    _perf.tid = tid;
+    for (i = 0; i < PERF_EVENTS; i++) {
+        _perf.fds[i] = -1;
+    }
+    for (i = 0; i < PERF_HARDWARE; i++) {
+        if ((_perf.fds[i] = perf_open_event(&_perf_events[i])) >= 0) {
+            count++;
+        }
+    }
+    if (count > 0) {
+        return count;
+    }
+    for (i = PERF_HARDWARE; i < PERF_EVENTS; i++) {
+        if ((_perf.fds[i] = perf_open_event(&_perf_events[i])) >= 0) {
+            count++;
+        }
+    }
+#endif
+    return count;
+}
+
+/*
+ * the count of an event so far, scaled up when it was multiplexed,
+ * -1 when it is not counted
+ */
+static long long perf_read(int event) {
+#ifdef LCUT_PERF_EVENTS
+    unsigned long long  v[3];   /* value, time enabled, time running */
+
+    if (!_perf_on || _perf.tid == 0 || _perf.fds[event] < 0
+        || read(_perf.fds[event], v, sizeof(v)) != sizeof(v)) {
+        return -1;
+    }
+    if (v[2] == 0) {
+        return 0;
+    }
+    if (v[2] < v[1]) {
+        return (long long)((double)v[0] * v[1] / v[2]);
+    }
+    return (long long)v[0];
+#else
+    return -1;
+#endif
+}
+
+static void perf_start(void) {
+#ifdef LCUT_PERF_EVENTS
+    int i;
+
+    if (!_perf_on || perf_open() == 0) {
+        return;
+    }
+    for (i = 0; i < PERF_EVENTS; i++) {
+        if (_perf.fds[i] >= 0) {
+            ioctl(_perf.fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(_perf.fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+static void perf_stop(lcut_perf_t *perf) {
+#ifdef LCUT_PERF_EVENTS
+    int i;
+
+    if (!_perf_on || _perf.tid == 0 || perf == NULL) {
+        return;
+    }
+    for (i = 0; i < PERF_EVENTS; i++) {
+        if (_perf.fds[i] >= 0) {
+            ioctl(_perf.fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (i = 0; i < PERF_EVENTS; i++) {
+        *(long long*)((char*)perf + _perf_events[i].offset) = perf_read(i);
+    }
+#endif
+}
+
+/*
+ * run the benchmark body for n iterations, returns the ns it took
+ */
+static long long bench_sample(lcut_tc_t *tc, tc_func func, long long n) {
+    lcut_bench_t    *b      = tc->bench;
+    long long       begin   = now_ns();
+    long long       end;
+
+    b->n     = n;
+    b->start = 0;
+    b->ops  += n;
+    func(tc, tc->para);
+    end = now_ns();
+
+    return end - (b->start > 0 ? b->start : begin);
+}
+
+static int double_cmp(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+#define LCUT_BENCH_SAMPLE_NS    1000000LL   /* the duration of a calibrated sample */
+#define LCUT_BENCH_MIN_SAMPLES  5           /* taken even when over the budget */
+#define LCUT_BENCH_RESAMPLES    1000        /* the bootstrap resamples of an A/B benchmark */
+
+static double median_of(double *v, int k) {
+    qsort(v, k, sizeof(double), double_cmp);
+    return (k % 2) ? v[k / 2] : (v[k / 2 - 1] + v[k / 2]) / 2;
+}
+
+/*
+ * the two-sided p-value of the Mann-Whitney U test, by the normal
+ * approximation corrected for ties, and z > 0 when a tends to be bigger
+ */
+static double mann_whitney(const double *a, const double *b, int k, double *z) {
+    double  *all    = NULL;
+    double  ra      = 0;
+    double  ties    = 0;
+    double  n       = 2.0 * k;
+    double  u, mu, sigma, rank;
+    int     i, j, m;
+
+    (*z) = 0;
+    if ((all = malloc(2 * k * sizeof(double))) == NULL) {
+        return 1;
+    }
+    memcpy(all, a, k * sizeof(double));
+    memcpy(all + k, b, k * sizeof(double));
+    qsort(all, 2 * k, sizeof(double), double_cmp);
+
+    /* the rank sum of a, ties get their average rank */
+    for (i = 0; i < 2 * k; i = j) {
+        for (j = i + 1; j < 2 * k && all[j] == all[i]; j++) {
+            ;
+        }
+        rank  = (i + 1 + j) / 2.0;
+        ties += (double)(j - i) * (j - i) * (j - i) - (j - i);
+        for (m = 0; m < k; m++) {
+            if (a[m] == all[i]) {
+                ra += rank;
+            }
+        }
+    }
+    free(all);
+
+    u     = ra - k * (k + 1) / 2.0;
+    mu    = k * (double)k / 2;
+    sigma = sqrt(k * (double)k / 12 * ((n + 1) - ties / (n * (n - 1))));
+    if (sigma <= 0) {
+        return 1;
+    }
+
+    (*z) = (u - mu) / sigma;
+    return erfc(fabs(*z) / sqrt(2.0));
+}
+
+/*
+ * take the samples of A and B by turns, ABBA, so that a drift of the
+ * machine hits both the same
+ */
+static void run_bench_ab(lcut_tc_t *tc, long long n) {
+    lcut_bench_t    *b      = tc->bench;
+    double          *a_ns   = NULL;
+    double          *b_ns   = NULL;
+    double          *ra     = NULL;
+    double          *rb     = NULL;
+    double          *ratios = NULL;
+    long long       budget  = (long long)b->wanted * LCUT_BENCH_SAMPLE_NS * 2;
+    long long       spent   = 0;
+    lcut_rng_t      rng;
+    double          z;
+    int             i, j, k;
+
+    a_ns   = malloc(b->wanted * sizeof(double));
+    b_ns   = malloc(b->wanted * sizeof(double));
+    ra     = malloc(b->wanted * sizeof(double));
+    rb     = malloc(b->wanted * sizeof(double));
+    ratios = malloc(LCUT_BENCH_RESAMPLES * sizeof(double));
+    if (a_ns == NULL || b_ns == NULL || ra == NULL || rb == NULL || ratios == NULL) {
+        goto done;
+    }
+
+    for (i = 0; i < b->wanted && (i < LCUT_BENCH_MIN_SAMPLES || spent < budget); i++) {
+        if (i % 2 == 0) {
+            a_ns[i] = (double)bench_sample(tc, tc->func, n);
+            b_ns[i] = (double)bench_sample(tc, b->func_b, n);
+        } else {
+            b_ns[i] = (double)bench_sample(tc, b->func_b, n);
+            a_ns[i] = (double)bench_sample(tc, tc->func, n);
+        }
+        if (tc->status == TEST_CASE_FAILURE) {
+            goto done;
+        }
+        spent  += (long long)(a_ns[i] + b_ns[i]);
+        a_ns[i] /= n;
+        b_ns[i] /= n;
+    }
+    k = i;
+
+    b->samples = k;
+    b->p_value = mann_whitney(a_ns, b_ns, k, &z);
+
+    /* the bootstrap distribution of the ratio of the medians */
+    rng_seed(&rng, (unsigned long long)k * 0x9e3779b97f4a7c15ULL + n);
+    for (j = 0; j < LCUT_BENCH_RESAMPLES; j++) {
+        for (i = 0; i < k; i++) {
+            ra[i] = a_ns[rng_below(&rng, k)];
+            rb[i] = b_ns[rng_below(&rng, k)];
+        }
+        z = median_of(rb, k);
+        ratios[j] = z > 0 ? median_of(ra, k) / z : 0;
+    }
+    qsort(ratios, LCUT_BENCH_RESAMPLES, sizeof(double), double_cmp);
+    b->speedup_lo = ratios[LCUT_BENCH_RESAMPLES * 25 / 1000];
+    b->speedup_hi = ratios[LCUT_BENCH_RESAMPLES * 975 / 1000 - 1];
+
+    /* min, mean... are those of A */
+    memcpy(ra, a_ns, k * sizeof(double));
+    b->median_b_ns = median_of(b_ns, k);
+    b->median_ns   = median_of(ra, k);
+    b->min_ns      = ra[0];
+    b->p99_ns      = ra[(k * 99 + 99) / 100 - 1];
+    for (b->mean_ns = 0, i = 0; i < k; i++) {
+        b->mean_ns += ra[i] / k;
+    }
+    for (b->stddev_ns = 0, i = 0; i < k; i++) {
+        b->stddev_ns += (ra[i] - b->mean_ns) * (ra[i] - b->mean_ns);
+    }
+    b->stddev_ns = k > 1 ? sqrt(b->stddev_ns / (k - 1)) : 0;
+    b->speedup   = b->median_b_ns > 0 ? b->median_ns / b->median_b_ns : 0;
+
+    if (b->margin >= 0
+        && (b->speedup_lo < 1 + b->margin / 100.0 || b->p_value >= 0.05 || b->speedup < 1)) {
+        FILL_IN_FAILED_REASON(tc, NULL, NULL, 0,
+                              "B is not faster than A by %d%%, speedup %.3fx, 95%% CI [%.3f, %.3f], p=%.4f",
+                              b->margin, b->speedup, b->speedup_lo, b->speedup_hi, b->p_value);
+    }
+
+done:
+    free(a_ns);
+    free(b_ns);
+    free(ra);
+    free(rb);
+    free(ratios);
+}
+
+static void run_bench(lcut_tc_t *tc) {
+    lcut_bench_t    *b      = tc->bench;
+    double          *ns     = NULL;
+    double          sum     = 0;
+    double          var     = 0;
+    long long       budget  = (long long)b->wanted * LCUT_BENCH_SAMPLE_NS;
+    long long       spent   = 0;
+    long long       n       = 1;
+    long long       t;
+    double          grow;
+    int             i, k;
+
+    b->samples = 0;
+    b->ops     = 0;
+
+    /* calibrate, which warms up too */
+    for (;;) {
+        t = bench_sample(tc, tc->func, n);
+        if (tc->status == TEST_CASE_FAILURE) {
+            return;
+        }
+        if (b->func_b != NULL) {
+            t = (t + bench_sample(tc, b->func_b, n)) / 2;
+            if (tc->status == TEST_CASE_FAILURE) {
+                return;
+            }
+        }
+        if (t >= LCUT_BENCH_SAMPLE_NS || n >= (1LL << 40)) {
+            break;
+        }
+        grow = t > 0 ? (double)LCUT_BENCH_SAMPLE_NS * 1.2 / t : 100;
+        grow = grow < 2 ? 2 : (grow > 100 ? 100 : grow);
+        n = (long long)(n * grow);
+    }
+    b->iters = n;
+
+    if (b->func_b != NULL) {
+        run_bench_ab(tc, n);
+        return;
+    }
+
+    if ((ns = malloc(b->wanted * sizeof(double))) == NULL) {
+        return;
+    }
+
+    /* a slow body gets fewer samples, so that the budget is kept */
+    for (i = 0; i < b->wanted && (i < LCUT_BENCH_MIN_SAMPLES || spent < budget); i++) {
+        t = bench_sample(tc, tc->func, n);
+        if (tc->status == TEST_CASE_FAILURE) {
+            free(ns);
+            return;
+        }
+        spent += t;
+        ns[i] = (double)t / n;
+        sum  += ns[i];
+    }
+
+    k = i;
+    qsort(ns, k, sizeof(double), double_cmp);
+    b->samples   = k;
+    b->min_ns    = ns[0];
+    b->median_ns = (k % 2) ? ns[k / 2] : (ns[k / 2 - 1] + ns[k / 2]) / 2;
+    b->p99_ns    = ns[(k * 99 + 99) / 100 - 1];
+    b->mean_ns   = sum / k;
+    for (i = 0; i < k; i++) {
+        var += (ns[i] - b->mean_ns) * (ns[i] - b->mean_ns);
+    }
+    b->stddev_ns = k > 1 ? sqrt(var / (k - 1)) : 0;
+
+    free(ns);
+}
+
+long long lcut_bench_n(lcut_tc_t *tc) {
+    if (tc->bench == NULL) {
+        return 1;
+    }
+
+    tc->bench->start = now_ns();
+    return tc->bench->n;
+}
+
+/*
+ * the property case running on a thread. an input is the sequence of its
+ * draws, each in [0, max], so that it shrinks by replaying fewer and
+ * smaller draws whatever the generators make of them
+ */
+#define LCUT_PROP_SHRINKS   10000       /* the runs of the func spent shrinking an input */
+#define LCUT_PROP_LOG       512         /* the text of the shrunk input */
+
+typedef struct lcut_prop_run_t {
+    int                         active;     /* 1: a property case runs on the thread */
+    lcut_rng_t                  rng;
+    unsigned long long          *draws;     /* the draws of the input */
+    int                         ndraws;
+    int                         cap;
+    int                         lost;       /* 1: a draw could not be recorded */
+    const unsigned long long    *replay;    /* the draws to replay, NULL: from rng */
+    int                         nreplay;    /* the draws past them are 0 */
+    int                         logging;    /* 1: the generated values are logged */
+    size_t                      loglen;
+    char                        log[LCUT_PROP_LOG];
+} lcut_prop_run_t;
+
+static __thread lcut_prop_run_t _prop;
+
+/*
+ * the best input found by the shrinking, and the candidate replayed
+ */
+typedef struct lcut_shrink_t {
+    unsigned long long          *best;
+    unsigned long long          *cand;
+    int                         n;          /* the draws of best */
+    int                         cap;        /* of best and cand */
+    int                         tries;
+    int                         shrinks;
+} lcut_shrink_t;
+
+static void prop_record(unsigned long long v) {
+    lcut_prop_run_t     *p      = &_prop;
+    unsigned long long  *draws  = NULL;
+    int                 cap, on;
+
+    if (p->lost) {
+        return;
+    }
+    if (p->ndraws == p->cap) {
+        cap = p->cap > 0 ? p->cap * 2 : 64;
+        on = alloc_pause();
+        draws = realloc(p->draws, cap * sizeof(unsigned long long));
+        alloc_resume(on);
+        if (draws == NULL) {
+            p->lost = 1;
+            return;
+        }
+        p->draws = draws;
+        p->cap   = cap;
+    }
+    p->draws[p->ndraws++] = v;
+}
+
+/*
+ * a draw in [0, max], one in 8 of the fresh ones is 0, 1, max or max - 1,
+ * where the bugs are
+ */
+static unsigned long long prop_draw(lcut_tc_t *tc, unsigned long long max) {
+    lcut_prop_run_t     *p  = &_prop;
+    unsigned long long  v, r;
+
+    if (tc->prop == NULL || !p->active) {
+        return 0;
+    }
+
+    if (p->replay != NULL) {
+        v = p->ndraws < p->nreplay ? p->replay[p->ndraws] : 0;
+        v = v < max ? v : max;
+    } else if (((r = rng_next(&(p->rng))) & 7) == 0) {
+        switch ((r >> 3) & 3) {
+        case 0:  v = 0; break;
+        case 1:  v = max > 0; break;
+        case 2:  v = max; break;
+        default: v = max - (max > 0); break;
+        }
+    } else {
+        v = max == ~0ULL ? rng_next(&(p->rng)) : rng_below(&(p->rng), max + 1);
+    }
+    prop_record(v);
+
+    return v;
+}
+
+static void prop_log(const char *fmt, ...) {
+    lcut_prop_run_t     *p  = &_prop;
+    va_list             ap;
+    int                 n;
+
+    if (!p->logging || p->loglen >= sizeof(p->log) - 1) {
+        return;
+    }
+
+    if (p->loglen > 0) {
+        p->loglen += snprintf(p->log + p->loglen, sizeof(p->log) - p->loglen, ", ");
+    }
+    if (p->loglen < sizeof(p->log) - 1) {
+        va_start(ap, fmt);
+        n = vsnprintf(p->log + p->loglen, sizeof(p->log) - p->loglen, fmt, ap);
+        va_end(ap);
+        p->loglen += n > 0 ? n : 0;
+    }
+    if (p->loglen > sizeof(p->log) - 1) {
+        p->loglen = sizeof(p->log) - 1;
+    }
+}
+
+/*
+ * the chars of a generated buffer, escaped and cut after 32 of them
+ */
+static void prop_log_chars(const unsigned char *s, size_t len, int quote) {
+    char    buf[32 * 4 + 8];
+    size_t  n   = 0;
+    size_t  i;
+
+    if (!_prop.logging) {
+        return;
+    }
+
+    buf[n++] = quote;
+    for (i = 0; i < len && i < 32; i++) {
+        if (s[i] >= 0x20 && s[i] < 0x7f && s[i] != quote && s[i] != '\\') {
+            buf[n++] = s[i];
+        } else {
+            n += sprintf(buf + n, "\\x%02x", s[i]);
+        }
+    }
+    n += sprintf(buf + n, "%s%c", i < len ? "..." : "", quote);
+    prop_log("%s", buf);
+}
+
+int lcut_gen_int(lcut_tc_t *tc) {
+    unsigned long long  v   = prop_draw(tc, 0xffffffffULL);
+    /* zigzag, so that the draws shrinking toward 0 make ints toward 0 */
+    int                 i   = (int)(v >> 1) ^ -(int)(v & 1);
+
+    prop_log("%d", i);
+    return i;
+}
+
+long long lcut_gen_range(lcut_tc_t *tc, long long lo, long long hi) {
+    long long   v;
+
+    if (hi < lo) {
+        v = lo, lo = hi, hi = v;
+    }
+    v = (long long)((unsigned long long)lo
+                    + prop_draw(tc, (unsigned long long)hi - (unsigned long long)lo));
+
+    prop_log("%lld", v);
+    return v;
+}
+
+size_t lcut_gen_bytes(lcut_tc_t *tc, void *buf, size_t max) {
+    unsigned char   *b  = buf;
+    size_t          n   = (size_t)prop_draw(tc, max);
+    size_t          i;
+
+    for (i = 0; i < n; i++) {
+        b[i] = (unsigned char)prop_draw(tc, 255);
+    }
+
+    prop_log_chars(b, n, '\'');
+    return n;
+}
+
+size_t lcut_gen_string(lcut_tc_t *tc, char *buf, size_t size, const char *alphabet) {
+    size_t  len, n, i;
+
+    if (size == 0) {
+        return 0;
+    }
+    if (alphabet == NULL || *alphabet == '\0') {
+        alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+                   " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+    }
+
+    len = strlen(alphabet);
+    n   = (size_t)prop_draw(tc, size - 1);
+    for (i = 0; i < n; i++) {
+        buf[i] = alphabet[prop_draw(tc, len - 1)];
+    }
+    buf[n] = '\0';
+
+    prop_log_chars((const unsigned char *)buf, n, '"');
+    return n;
+}
+
+/*
+ * shortlex, fewer draws first, then the smaller ones
+ */
+static int prop_simpler(const unsigned long long *a, int na, const unsigned long long *b, int nb) {
+    int i;
+
+    if (na != nb) {
+        return na < nb;
+    }
+    for (i = 0; i < na; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * run the func on the first n draws of the candidate, the draws it takes
+ * become the best input when it still fails and they are simpler
+ */
+static int prop_try(lcut_tc_t *tc, void *para, lcut_shrink_t *s, int n) {
+    lcut_prop_run_t     *p  = &_prop;
+    unsigned long long  *best, *cand;
+    int                 cap, on;
+
+    s->tries++;
+    p->replay  = s->cand;
+    p->nreplay = n;
+    p->ndraws  = 0;
+    p->lost    = 0;
+    tc->status = TEST_CASE_SUCCESS;
+    tc->func(tc, para);
+    p->replay  = NULL;
+
+    if (tc->status != TEST_CASE_FAILURE || p->lost
+        || !prop_simpler(p->draws, p->ndraws, s->best, s->n)) {
+        return 0;
+    }
+
+    if (p->ndraws > s->cap) {
+        cap = p->cap;
+        on = alloc_pause();
+        best = realloc(s->best, cap * sizeof(unsigned long long));
+        cand = best != NULL ? realloc(s->cand, cap * sizeof(unsigned long long)) : NULL;
+        alloc_resume(on);
+        s->best = best != NULL ? best : s->best;
+        s->cand = cand != NULL ? cand : s->cand;
+        if (cand == NULL) {
+            return 0;
+        }
+        s->cap = cap;
+    }
+    memcpy(s->best, p->draws, p->ndraws * sizeof(unsigned long long));
+    s->n = p->ndraws;
+    s->shrinks++;
+
+    return 1;
+}
+
+/*
+ * drop runs of draws, the longest first, zero them, then make each draw
+ * as small as it goes, until a round shrinks nothing or the budget is spent
+ */
+static void prop_shrink_loop(lcut_tc_t *tc, void *para, lcut_shrink_t *s) {
+    const size_t        sz  = sizeof(unsigned long long);
+    unsigned long long  lo, hi, mid;
+    int                 progress, i, k;
+
+    do {
+        progress = 0;
+
+        for (k = 8; k >= 1; k /= 2) {
+            for (i = s->n - k; i >= 0 && s->tries < LCUT_PROP_SHRINKS; i--) {
+                if (i + k > s->n) {
+                    continue;
+                }
+                memcpy(s->cand, s->best, i * sz);
+                memcpy(s->cand + i, s->best + i + k, (s->n - i - k) * sz);
+                progress |= prop_try(tc, para, s, s->n - k);
+            }
+        }
+
+        for (k = 8; k >= 2; k /= 2) {
+            for (i = s->n - k; i >= 0 && s->tries < LCUT_PROP_SHRINKS; i--) {
+                if (i + k > s->n) {
+                    continue;
+                }
+                memcpy(s->cand, s->best, s->n * sz);
+                memset(s->cand + i, 0, k * sz);
+                progress |= prop_try(tc, para, s, s->n);
+            }
+        }
+
+        for (i = 0; i < s->n && s->tries < LCUT_PROP_SHRINKS; i++) {
+            lo = 0;
+            hi = s->best[i];
+            while (lo < hi && i < s->n && s->tries < LCUT_PROP_SHRINKS) {
+                /* 0 first, then a binary search */
+                mid = lo == 0 ? 0 : lo + (hi - lo) / 2;
+                memcpy(s->cand, s->best, s->n * sz);
+                s->cand[i] = mid;
+                if (prop_try(tc, para, s, s->n)) {
+                    progress = 1;
+                    hi = i < s->n ? s->best[i] : 0;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+        }
+    } while (progress && s->tries < LCUT_PROP_SHRINKS);
+}
+
+/*
+ * the first failed iteration is shrunk, then replayed once more for the
+ * failure and the input to report
+ */
+static void prop_shrink(lcut_tc_t *tc, void *para, int iteration) {
+    lcut_prop_run_t     *p          = &_prop;
+    long long           asserts     = tc->asserts;
+    lcut_shrink_t       s;
+    char                reason[LCUT_MAX_STR_LEN];
+    char                detail[LCUT_MAX_DETAIL_LEN];
+    char                *old        = NULL;
+    int                 on;
+
+    memset(&s, 0, sizeof(s));
+    if (!p->lost) {
+        s.cap = p->ndraws > 0 ? p->ndraws : 1;
+        on = alloc_pause();
+        s.best = malloc(s.cap * sizeof(unsigned long long));
+        s.cand = malloc(s.cap * sizeof(unsigned long long));
+        alloc_resume(on);
+    }
+
+    if (s.best != NULL && s.cand != NULL) {
+        memcpy(s.best, p->draws, p->ndraws * sizeof(unsigned long long));
+        s.n = p->ndraws;
+        prop_shrink_loop(tc, para, &s);
+
+        on = alloc_pause();
+        failure_free(tc);
+        alloc_resume(on);
+
+        memcpy(s.cand, s.best, s.n * sizeof(unsigned long long));
+        p->logging = 1;
+        p->loglen  = 0;
+        p->log[0]  = '\0';
+        prop_try(tc, para, &s, s.n);
+        p->logging = 0;
+    }
+    tc->asserts = asserts;
+
+    if (tc->status != TEST_CASE_FAILURE) {
+        FILL_IN_FAILED_REASON(tc, NULL, NULL, 0,
+                              "seed %llu, iteration %d: failed, but not on the replay of its input",
+                              _prop_seed, iteration);
+    } else if (tc->failure != NULL) {
+        snprintf(reason, sizeof(reason), "%s", tc->failure->reason);
+        snprintf(tc->failure->reason, LCUT_MAX_STR_LEN, "seed %llu, iteration %d%s%.*s",
+                 _prop_seed, iteration, reason[0] != '\0' ? ": " : "", LCUT_MAX_STR_LEN - 48, reason);
+    }
+
+    if (tc->failure != NULL && s.best != NULL && s.cand != NULL) {
+        /* the input goes first, the lines of the assertion under it */
+        old = tc->failure->detail;
+        tc->failure->detail = NULL;
+        snprintf(detail, sizeof(detail), "\t\t\tinput: %s (shrunk %d times)\n%s",
+                 p->log[0] != '\0' ? p->log : "none", s.shrinks, old != NULL ? old : "");
+        failure_detail(tc, detail);
+    }
+
+    on = alloc_pause();
+    free(old);
+    free(s.best);
+    free(s.cand);
+    alloc_resume(on);
+}
+
+static void prop_end(void) {
+    int on;
+
+    if (_prop.draws != NULL) {
+        on = alloc_pause();
+        free(_prop.draws);
+        alloc_resume(on);
+    }
+    memset(&_prop, 0, offsetof(lcut_prop_run_t, log));
+}
+
+/*
+ * the iterations of the case or of its part, each input drawn from its
+ * own seed, so that an iteration is replayed by its seed alone
+ */
+static void run_prop(lcut_tc_t *tc, void *para) {
+    lcut_prop_t         *prop   = tc->prop;
+    lcut_prop_run_t     *p      = &_prop;
+    const char          *name   = tc->rows != NULL ? tc->rows->tc->desc : tc->desc;
+    unsigned long long  key     = hash_str(_prop_seed, name);
+    int                 it      = tc->rows != NULL ? tc->row * prop->part : 0;
+    int                 end     = prop->iterations - it > prop->part ? it + prop->part : prop->iterations;
+
+    prop_end();
+    p->active = 1;
+    for (; it < end; it++) {
+        rng_seed(&(p->rng), hash_mix(key + it));
+        p->ndraws = 0;
+        p->lost   = 0;
+        tc->func(tc, para);
+        if (tc->status == TEST_CASE_FAILURE) {
+            prop_shrink(tc, para, it);
+            break;
+        }
+    }
+    prop_end();
+}
+
+static void run_case(lcut_plan_tc_t *c) {
+    lcut_tc_t   *tc     = c->tc;
+    void        *para   = tc->para;
+    long long   start   = now_ns();
+    long long   wall, cpu;
+    /* a generated row lives on the stack while its case runs */
+    long double row[tc->rows != NULL && tc->rows->gen != NULL ?
+                    tc->rows->stride / sizeof(long double) + 1 : 1];
+
+    tc->wall_ns    = 0;
+    tc->cpu_ns     = 0;
+    tc->fixture_ns = 0;
+    tc->asserts    = 0;
+    memset(&(tc->allocs), 0, sizeof(tc->allocs));
+    if (tc->perf != NULL) {
+        memset(tc->perf, 0xff, sizeof(lcut_perf_t));
+    }
+
+    c->phase = CASE_BEFORE;
+    if (tc->before != NULL) {
+        tc->before();
+    }
+    if (tc->rows != NULL && tc->rows->gen != NULL) {
+        memset(row, 0, sizeof(row));
+        tc->rows->gen(tc->rows->data, tc->row, row);
+        para = row;
+    }
+
+    c->phase = CASE_FUNC;
+    wall = now_ns();
+    cpu  = cpu_ns();
+    perf_start();
+    if (tc->bench != NULL) {
+        run_bench(tc);
+    } else if (tc->prop != NULL) {
+        alloc_begin();
+        run_prop(tc, para);
+        alloc_end(&(tc->allocs));
+    } else {
+        alloc_begin();
+        tc->func(tc, para);
+        alloc_end(&(tc->allocs));
+    }
+    perf_stop(tc->perf);
+    tc->cpu_ns  = cpu_ns() - cpu;
+    tc->wall_ns = now_ns() - wall;
+
+    c->phase = CASE_AFTER;
+    if (tc->after != NULL) {
+        tc->after();
+    }
+
+    c->elapsed_ns  = now_ns() - start;
+    tc->fixture_ns = c->elapsed_ns - tc->wall_ns;
+}
+
+static void timeout_case(lcut_plan_tc_t *c) {
+    FILL_IN_FAILED_REASON(c->tc, NULL, NULL, 0,
+                          "timeout after %d ms", c->timeout_ms);
+    c->elapsed_ns      = (long long)c->timeout_ms * 1000000LL;
+    c->tc->wall_ns     = c->elapsed_ns;
+    c->tc->fixture_ns  = 0;
+}
+
+/*
+ * run the setup and the teardown of a suite, timed
+ */
+static long long suite_setup(lcut_ts_t *ts) {
+    long long   start;
+
+    if (ts->setup == NULL) {
+        return 0;
+    }
+
+    start = now_ns();
+    ts->setup();
+    start = now_ns() - start;
+    ATOMIC_ADD(&(ts->setup_ns), start);
+
+    return start;
+}
+
+static long long suite_teardown(lcut_ts_t *ts) {
+    long long   start;
+
+    if (ts->teardown == NULL) {
+        return 0;
+    }
+
+    start = now_ns();
+    ts->teardown();
+    start = now_ns() - start;
+    ATOMIC_ADD(&(ts->teardown_ns), start);
+
+    return start;
+}
+
+static void on_timeout(int sig) {
+    if (_timeout_armed) {
+        _timeout_armed = 0;
+        siglongjmp(_timeout_jmp, 1);
+    }
+}
+
+static void arm_timer(int ms) {
+    struct itimerval it;
+
+    memset(&it, 0, sizeof(it));
+    it.it_value.tv_sec  = ms / 1000;
+    it.it_value.tv_usec = (ms % 1000) * 1000;
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/*
+ * run a case under a SIGALRM watchdog, jumping out of it when it hangs
+ */
+static void run_case_watched(lcut_plan_tc_t *c) {
+    lcut_tc_t   *tc     = c->tc;
+
+    if (c->timeout_ms <= 0) {
+        run_case(c);
+        return;
+    }
+
+    if (sigsetjmp(_timeout_jmp, 1) == 0) {
+        _timeout_armed = 1;
+        arm_timer(c->timeout_ms);
+        run_case(c);
+        _timeout_armed = 0;
+        arm_timer(0);
+        return;
+    }
+
+    alloc_end(NULL);
+    prop_end();
+    timeout_case(c);
+
+    /* the after fixture is still owed unless it is the one hanging */
+    if (c->phase != CASE_AFTER && tc->after != NULL) {
+        tc->after();
+    }
+}
+
+/*
+ * a benchmark regressed when its median is slower than the baseline by
+ * more than the threshold, and the slowdown of its mean is beyond the
+ * noise, 3 standard errors of the difference of the means
+ */
+static void bench_compare(lcut_plan_t *plan, lcut_plan_tc_t *c) {
+    lcut_bench_t    *cur    = c->tc->bench;
+    lcut_bench_t    *base   = c->base;
+    double          change, noise;
+
+    if (c->tc->status != TEST_CASE_SUCCESS || base->median_ns <= 0 || cur->samples == 0) {
+        return;
+    }
+
+    change = (cur->median_ns - base->median_ns) / base->median_ns * 100;
+    noise  = 3 * sqrt(cur->stddev_ns * cur->stddev_ns / cur->samples
+                      + base->stddev_ns * base->stddev_ns / (base->samples > 0 ? base->samples : 1));
+
+    if (change > plan->max_regression && cur->mean_ns - base->mean_ns > noise) {
+        FILL_IN_FAILED_REASON(c->tc, NULL, NULL, 0,
+                              "regressed by %.1f%%, median %.2f ns/op > baseline %.2f ns/op",
+                              change, cur->median_ns, base->median_ns);
+    }
+}
+
+/*
+ * account a finished case to its suite, may be called from any thread
+ */
+static void finish_case(lcut_plan_t *plan, lcut_plan_tc_t *c) {
+    lcut_ts_t   *ts = plan->suites[c->suite].ts;
+
+    if (c->base != NULL && c->tc->bench != NULL && c->tc->bench->func_b == NULL) {
+        bench_compare(plan, c);
+    }
+
+    c->failed = c->tc->status == TEST_CASE_FAILURE;
+    if (c->failed) {
+        ATOMIC_INC(&(ts->failed));
+        ATOMIC_INC(&(plan->failures));
+    } else if (plan->slow_ms > 0 && c->elapsed_ns > (long long)plan->slow_ms * 1000000LL) {
+        ATOMIC_INC(&(ts->slow));
+    }
+
+    if (history_flaky((c->history << 1) | c->failed, c->runs + 1)) {
+        c->flaky = 1;
+        ATOMIC_INC(&(ts->flaky));
+    }
+}
+
+/*
+ * whether the run stopped handing the cases out, after too many failures
+ */
+static int plan_stopped(lcut_plan_t *plan) {
+    return plan->max_failures > 0 && plan->failures >= plan->max_failures;
+}
+
+static void skip_case(lcut_plan_t *plan, lcut_plan_tc_t *c) {
+    c->skipped = 1;
+    ATOMIC_INC(&(plan->skipped));
+    c->done = 1;
+}
+
+/*
+ * "1.234 ms, cpu 1.200 ms, fixtures 0.010 ms, 12 assertions"
+ */
+static void format_times(char *buf, size_t len, lcut_tc_t *tc) {
+    size_t  n;
+
+    n = snprintf(buf, len, "%.3f ms, cpu %.3f ms", tc->wall_ns / 1e6, tc->cpu_ns / 1e6);
+    if ((tc->before != NULL || tc->after != NULL) && n < len) {
+        n += snprintf(buf + n, len - n, ", fixtures %.3f ms", tc->fixture_ns / 1e6);
+    }
+    if (tc->asserts > 0 && n < len) {
+        n += snprintf(buf + n, len - n, ", %lld assertion%s", tc->asserts, tc->asserts > 1 ? "s" : "");
+    }
+    if (tc->allocs.count > 0 && n < len) {
+        n += snprintf(buf + n, len - n, ", %lld allocs of %lld bytes, peak %lld bytes",
+                      tc->allocs.count, tc->allocs.bytes, tc->allocs.peak);
+    }
+    if (tc->allocs.leaks > 0 && n < len) {
+        snprintf(buf + n, len - n, ", %lld blocks of %lld bytes leaked",
+                 tc->allocs.leaks, tc->allocs.leaked);
+    }
+}
+
+static void perf_append(char *buf, size_t len, size_t *n, const char *name,
+                        long long count, long long ops) {
+    if (count < 0 || *n >= len) {
+        return;
+    }
+    if (ops > 0) {
+        (*n) += snprintf(buf + *n, len - *n, "%s%.2f %s", *n > 0 ? ", " : "", (double)count / ops, name);
+    } else {
+        (*n) += snprintf(buf + *n, len - *n, "%s%lld %s", *n > 0 ? ", " : "", count, name);
+    }
+}
+
+/*
+ * "12345 instructions, 6789 cycles, 1.82 IPC, 12 branch-misses, ...",
+ * per op for a benchmark, empty when nothing was counted
+ */
+static void format_perf(char *buf, size_t len, lcut_tc_t *tc) {
+    const lcut_perf_t   *p      = tc->perf;
+    long long           ops     = tc->bench != NULL ? tc->bench->ops : 0;
+    size_t              n       = 0;
+
+    buf[0] = '\0';
+    if (p == NULL) {
+        return;
+    }
+    perf_append(buf, len, &n, "instructions", p->instructions, ops);
+    perf_append(buf, len, &n, "cycles", p->cycles, ops);
+    if (p->instructions >= 0 && p->cycles > 0 && n < len) {
+        n += snprintf(buf + n, len - n, ", %.2f IPC", (double)p->instructions / p->cycles);
+    }
+    perf_append(buf, len, &n, "branch-misses", p->branch_misses, ops);
+    perf_append(buf, len, &n, "L1d-misses", p->l1d_misses, ops);
+    perf_append(buf, len, &n, "LLC-misses", p->llc_misses, ops);
+    if (p->task_clock_ns >= 0 && ops > 0 && n < len) {
+        n += snprintf(buf + n, len - n, "%stask-clock %.2f ns", n > 0 ? ", " : "", (double)p->task_clock_ns / ops);
+    } else if (p->task_clock_ns >= 0 && n < len) {
+        n += snprintf(buf + n, len - n, "%stask-clock %.3f ms", n > 0 ? ", " : "", p->task_clock_ns / 1e6);
+    }
+    perf_append(buf, len, &n, "page-faults", p->page_faults, ops);
+    perf_append(buf, len, &n, "context-switches", p->context_switches, ops);
+    if (ops > 0 && n > 0 && n < len) {
+        snprintf(buf + n, len - n, " per op");
+    }
+}
+
+/*
+ * the buffered output of the reporters, a writer on no file keeps what
+ * is written in memory and grows instead of writing it out
+ */
+struct lcut_writer_t {
+    int                         fd;         /* -1: in memory */
+    char                        *buf;
+    size_t                      len;
+    size_t                      cap;
+    int                         live;       /* 1: a terminal or a pipe, written out after each case */
+    int                         plain;      /* 1: not a terminal, the colour codes are dropped */
+    int                         error;      /* the errno of the first failed write */
+    int                         refs;       /* the reporters writing into it */
+};
+
+/* the reporters printing to the stdout share one writer */
+static lcut_writer_t    *_stdout_writer = NULL;
+
+/*
+ * a terminal or a pipe has a reader following it, e.g. lcut-run reading
+ * the JSON lines of a binary, which must not wait for the end of the run
+ */
+static int writer_live(int fd) {
+    struct stat st;
+
+    if (isatty(fd)) {
+        return 1;
+    }
+    return fstat(fd, &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode));
+}
+
+static lcut_writer_t* writer_open(const char *path) {
+    lcut_writer_t   *w  = NULL;
+
+    if (path != NULL && !strcmp(path, "-") && _stdout_writer != NULL) {
+        _stdout_writer->refs++;
+        return _stdout_writer;
+    }
+
+    if ((w = calloc(1, sizeof(*w))) == NULL) {
+        return NULL;
+    }
+    w->cap = path != NULL ? LCUT_WRITER_BUF : LCUT_WRITER_MEM;
+    if ((w->buf = malloc(w->cap)) == NULL) {
+        free(w);
+        return NULL;
+    }
+    w->refs = 1;
+
+    if (path == NULL) {
+        w->fd = -1;
+    } else if (!strcmp(path, "-")) {
+        w->fd    = STDOUT_FILENO;
+        w->live  = writer_live(STDOUT_FILENO);
+        w->plain = !isatty(STDOUT_FILENO);
+        _stdout_writer = w;
+    } else if ((w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        free(w->buf);
+        free(w);
+        return NULL;
+    } else {
+        w->live = writer_live(w->fd);
+    }
+
+    return w;
+}
+
+static void writer_drain(lcut_writer_t *w) {
+    size_t  off = 0;
+    ssize_t n;
+
+    while (off < w->len) {
+        n = write(w->fd, w->buf + off, w->len - off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (w->error == 0) {
+                w->error = n < 0 ? errno : EIO;
+            }
+            break;
+        }
+        off += n;
+    }
+    w->len = 0;
+}
+
+void lcut_writer_flush(lcut_writer_t *w) {
+    if (w == NULL || w->fd < 0) {
+        return;
+    }
+
+    writer_drain(w);
+    /* what the cases printed since the last line of the reporters */
+    if (w->fd == STDOUT_FILENO) {
+        fflush(stdout);
+    }
+}
+
+/*
+ * what the cases and fixtures printed with stdio goes out after the lines
+ * of the reporters before it, and before the line coming. only what stdio
+ * still holds is known, what it wrote out by itself may come first
+ */
+static void writer_sync(lcut_writer_t *w) {
+#if defined(__GLIBC__)
+    if (w->fd == STDOUT_FILENO && __fpending(stdout) > 0) {
+        writer_drain(w);
+        fflush(stdout);
+    }
+#endif
+}
+
+/*
+ * drop the colour codes, "\033[...m", from the bytes written since start
+ */
+static void writer_plain(lcut_writer_t *w, size_t start) {
+    char    *src    = w->buf + start;
+    char    *dst    = src;
+    char    *end    = w->buf + w->len;
+    char    *m;
+
+    if (memchr(src, '\033', end - src) == NULL) {
+        return;
+    }
+    while (src < end) {
+        if (*src == '\033' && src + 1 < end && src[1] == '['
+            && (m = memchr(src, 'm', end - src)) != NULL) {
+            src = m + 1;
+            continue;
+        }
+        *dst++ = *src++;
+    }
+    w->len = dst - w->buf;
+    w->buf[w->len] = '\0';
+}
+
+static void writer_close(lcut_writer_t *w) {
+    if (w == NULL || --(w->refs) > 0) {
+        return;
+    }
+
+    lcut_writer_flush(w);
+    if (w->fd > STDERR_FILENO) {
+        close(w->fd);
+    }
+    if (w == _stdout_writer) {
+        _stdout_writer = NULL;
+    }
+    free(w->buf);
+    free(w);
+}
+
+/*
+ * room for n more bytes and the '\0', written out or grown
+ */
+static int writer_reserve(lcut_writer_t *w, size_t n) {
+    char    *p  = NULL;
+    size_t  cap;
+
+    if (w->len + n < w->cap) {
+        return 0;
+    }
+    lcut_writer_flush(w);
+    if (w->len + n < w->cap) {
+        return 0;
+    }
+
+    for (cap = w->cap * 2; cap <= w->len + n; cap *= 2) {
+        ;
+    }
+    if ((p = realloc(w->buf, cap)) == NULL) {
+        return ENOMEM;
+    }
+    w->buf = p;
+    w->cap = cap;
+
+    return 0;
+}
+
+static void writer_write(lcut_writer_t *w, const char *data, size_t len) {
+    writer_sync(w);
+    if (writer_reserve(w, len) == 0) {
+        memcpy(w->buf + w->len, data, len);
+        w->len += len;
+    }
+}
+
+int lcut_writer_printf(lcut_writer_t *w, const char *fmt, ...) {
+    va_list ap;
+    int     n;
+
+    if (w == NULL) {
+        return -1;
+    }
+
+    writer_sync(w);
+    va_start(ap, fmt);
+    n = vsnprintf(w->buf + w->len, w->cap - w->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        return n;
+    }
+
+    if ((size_t)n >= w->cap - w->len) {
+        if (writer_reserve(w, n) != 0) {
+            return -1;
+        }
+        va_start(ap, fmt);
+        vsnprintf(w->buf + w->len, w->cap - w->len, fmt, ap);
+        va_end(ap);
+    }
+    w->len += n;
+    if (w->plain) {
+        writer_plain(w, w->len - n);
+    }
+
+    return n;
+}
+
+static void writer_xml(lcut_writer_t *w, const char *str) {
+    for (; *str; str++) {
+        switch (*str) {
+        case '&': writer_write(w, "&amp;", 5); break;
+        case '<': writer_write(w, "&lt;", 4); break;
+        case '>': writer_write(w, "&gt;", 4); break;
+        case '"': writer_write(w, "&quot;", 6); break;
+        case '\'': writer_write(w, "&apos;", 6); break;
+        default:
+            /* the control characters but the blanks are not allowed in XML 1.0 */
+            if ((unsigned char)*str < 0x20 && *str != '\n' && *str != '\t' && *str != '\r') {
+                writer_write(w, "?", 1);
+            } else {
+                writer_write(w, str, 1);
+            }
+        }
+    }
+}
+
+static void writer_json(lcut_writer_t *w, const char *str) {
+    writer_write(w, "\"", 1);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            lcut_writer_printf(w, "\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            lcut_writer_printf(w, "\\u%04x", (unsigned char)*str);
+        } else {
+            writer_write(w, str, 1);
+        }
+    }
+    writer_write(w, "\"", 1);
+}
+
+/*
+ * a TAP description ends at the line, and at a '#' which is not escaped
+ */
+static void writer_tap(lcut_writer_t *w, const char *str) {
+    for (; *str; str++) {
+        if (*str == '#' || *str == '\\') {
+            lcut_writer_printf(w, "\\%c", *str);
+        } else if (*str == '\n' || *str == '\r') {
+            writer_write(w, " ", 1);
+        } else {
+            writer_write(w, str, 1);
+        }
+    }
+}
+
+/*
+ * the state of the reporters coming with lcut
+ */
+typedef struct lcut_builtin_t {
+    lcut_reporter_t             r;
+    lcut_test_t                 *test;
+    lcut_writer_t               *body;      /* junit: the cases of the suite being reported */
+    int                         tests;      /* the cases reported in the suite */
+    int                         failures;   /* the failed cases reported in the suite */
+    long long                   ns;         /* the time of the cases reported in the suite */
+    int                         cases;      /* the cases reported in the run */
+    int                         failed;     /* the failed cases reported in the run */
+} lcut_builtin_t;
+
+static void builtin_destroy(lcut_reporter_t *r) {
+    lcut_builtin_t  *b  = r->data;
+
+    writer_close(b->body);
+    free(b);
+}
+
+static void builtin_case_counted(lcut_builtin_t *b, const lcut_case_report_t *report) {
+    b->tests++;
+    b->cases++;
+    b->ns += report->elapsed_ns;
+    if (report->tc->status == TEST_CASE_FAILURE) {
+        b->failures++;
+        b->failed++;
+    }
+}
+
+static void console_run_start(lcut_reporter_t *r, lcut_test_t *test) {
+    if (!test->quiet) {
+        lcut_writer_printf(r->out, "%s \n", LCUT_LOGO);
+        lcut_writer_printf(r->out, "Unit Test for '%s':\n\n", test->desc);
+    }
+}
+
+static void console_suite_start(lcut_reporter_t *r, lcut_ts_t *ts) {
+    lcut_builtin_t  *b  = r->data;
+
+    if (!b->test->quiet) {
+        lcut_writer_printf(r->out, "\tSuite <%s>: \n", ts->desc);
+    }
+}
+
+/*
+ * a failure of no assertion, a crash or a timeout, has its reason only
+ */
+static void console_failure(lcut_writer_t *out, const char *name, lcut_tc_t *tc, const char *times) {
+    const lcut_failure_t    *f  = failure_of(tc);
+
+    if (f->fname != NULL) {
+        lcut_writer_printf(out, FAILURE_TIP_FMT, name, f->fcname, f->line, f->fname, f->reason, times);
+    } else {
+        lcut_writer_printf(out, FAILURE_REASON_FMT, name, f->reason, times);
+    }
+    if (f->detail != NULL) {
+        lcut_writer_printf(out, "%s", f->detail);
+    }
+}
+
+static void console_case_end(lcut_reporter_t *r, const lcut_case_report_t *report) {
+    lcut_builtin_t  *b  = r->data;
+    lcut_tc_t       *tc = report->tc;
+    char            name[LCUT_MAX_NAME_LEN * 2];
+    char            times[256];
+    char            perf[256];
+
+    format_times(times, sizeof(times), tc);
+
+    /* no suite titles to go by */
+    if (b->test->quiet) {
+        if (tc->status == TEST_CASE_FAILURE) {
+            snprintf(name, sizeof(name), "%s/%s", report->ts->desc, tc->desc);
+            console_failure(r->out, name, tc, times);
+        }
+        return;
+    }
+
+    if (report->slow) {
+        lcut_writer_printf(r->out, SLOW_TIP_FMT, tc->desc, report->elapsed_ns / 1000000LL,
+                           b->test->slow_ms, times);
+    } else if (tc->status == TEST_CASE_SUCCESS) {
+        lcut_writer_printf(r->out, SUCCESS_TIP_FMT, tc->desc, times);
+    } else if (tc->status == TEST_CASE_FAILURE) {
+        console_failure(r->out, tc->desc, tc, times);
+    }
+
+    if (tc->bench != NULL && tc->bench->samples > 0 && tc->bench->func_b != NULL) {
+        lcut_writer_printf(r->out, AB_TIP_FMT, tc->bench->median_ns, tc->bench->median_b_ns, tc->bench->speedup,
+                           tc->bench->speedup_lo, tc->bench->speedup_hi, tc->bench->p_value,
+                           tc->bench->samples, tc->bench->iters);
+    } else if (tc->bench != NULL && tc->bench->samples > 0) {
+        lcut_writer_printf(r->out, BENCH_TIP_FMT, tc->bench->min_ns, tc->bench->median_ns, tc->bench->mean_ns,
+                           tc->bench->p99_ns, tc->bench->stddev_ns, tc->bench->samples, tc->bench->iters);
+        if (report->baseline_ns > 0) {
+            lcut_writer_printf(r->out, BASELINE_TIP_FMT,
+                               (tc->bench->median_ns - report->baseline_ns) / report->baseline_ns * 100,
+                               report->baseline_ns);
+        }
+    }
+
+    format_perf(perf, sizeof(perf), tc);
+    if (perf[0] != '\0') {
+        lcut_writer_printf(r->out, PERF_TIP_FMT, perf);
+    }
+
+    if (report->flaky) {
+        lcut_writer_printf(r->out, FLAKY_TIP_FMT, tc->desc, report->runs);
+    }
+}
+
+/*
+ * the counts of a testsuite come before its testcases, which wait in
+ * the body till the suite ends
+ */
+static void junit_run_start(lcut_reporter_t *r, lcut_test_t *test) {
+    lcut_writer_printf(r->out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites name=\"");
+    writer_xml(r->out, test->desc);
+    lcut_writer_printf(r->out, "\">\n");
+}
+
+static void junit_suite_start(lcut_reporter_t *r, lcut_ts_t *ts) {
+    lcut_builtin_t  *b  = r->data;
+
+    b->tests    = 0;
+    b->failures = 0;
+    b->ns       = 0;
+    if (b->body == NULL) {
+        b->body = writer_open(NULL);
+    }
+}
+
+static void junit_case_end(lcut_reporter_t *r, const lcut_case_report_t *report) {
+    lcut_builtin_t  *b  = r->data;
+    lcut_writer_t   *w  = b->body;
+    lcut_tc_t       *tc = report->tc;
+
+    builtin_case_counted(b, report);
+    if (w == NULL) {
+        return;
+    }
+
+    lcut_writer_printf(w, "    <testcase classname=\"");
+    writer_xml(w, report->ts->desc);
+    lcut_writer_printf(w, "\" name=\"");
+    writer_xml(w, tc->desc);
+    lcut_writer_printf(w, "\" time=\"%.6f\"", report->elapsed_ns / 1e9);
+    if (tc->status != TEST_CASE_FAILURE) {
+        lcut_writer_printf(w, "/>\n");
+        return;
+    }
+
+    lcut_writer_printf(w, ">\n      <failure type=\"assertion\" message=\"");
+    writer_xml(w, failure_of(tc)->reason);
+    lcut_writer_printf(w, "\">");
+    if (failure_of(tc)->fname != NULL) {
+        writer_xml(w, failure_of(tc)->fname);
+        lcut_writer_printf(w, ":%d in ", failure_of(tc)->line);
+        writer_xml(w, failure_of(tc)->fcname);
+        lcut_writer_printf(w, ": ");
+    }
+    writer_xml(w, failure_of(tc)->reason);
+    if (failure_of(tc)->detail != NULL) {
+        lcut_writer_printf(w, "\n");
+        writer_xml(w, failure_of(tc)->detail);
+    }
+    lcut_writer_printf(w, "</failure>\n    </testcase>\n");
+}
+
+static void junit_suite_end(lcut_reporter_t *r, lcut_ts_t *ts) {
+    lcut_builtin_t  *b  = r->data;
+
+    lcut_writer_printf(r->out, "  <testsuite name=\"");
+    writer_xml(r->out, ts->desc);
+    lcut_writer_printf(r->out, "\" tests=\"%d\" failures=\"%d\" errors=\"0\" time=\"%.6f\">\n",
+                       b->tests, b->failures, b->ns / 1e9);
+    if (b->body != NULL) {
+        writer_write(r->out, b->body->buf, b->body->len);
+        b->body->len = 0;
+    }
+    lcut_writer_printf(r->out, "  </testsuite>\n");
+}
+
+static void junit_run_end(lcut_reporter_t *r, lcut_test_t *test) {
+    lcut_writer_printf(r->out, "</testsuites>\n");
+}
+
+/*
+ * the plan line goes last, the count of cases is known at the end only
+ */
+static void tap_run_start(lcut_reporter_t *r, lcut_test_t *test) {
+    lcut_writer_printf(r->out, "TAP version 13\n# ");
+    writer_tap(r->out, test->desc);
+    lcut_writer_printf(r->out, "\n");
+}
+
+static void tap_suite_start(lcut_reporter_t *r, lcut_ts_t *ts) {
+    lcut_writer_printf(r->out, "# ");
+    writer_tap(r->out, ts->desc);
+    lcut_writer_printf(r->out, "\n");
+}
+
+static void tap_case_end(lcut_reporter_t *r, const lcut_case_report_t *report) {
+    lcut_builtin_t  *b  = r->data;
+    lcut_tc_t       *tc = report->tc;
+
+    builtin_case_counted(b, report);
+
+    lcut_writer_printf(r->out, "%s %d - ", tc->status == TEST_CASE_FAILURE ? "not ok" : "ok", b->cases);
+    writer_tap(r->out, report->ts->desc);
+    lcut_writer_printf(r->out, "/");
+    writer_tap(r->out, tc->desc);
+    lcut_writer_printf(r->out, "\n");
+    if (tc->status != TEST_CASE_FAILURE) {
+        return;
+    }
+
+    /* the YAML block, JSON strings are YAML strings */
+    lcut_writer_printf(r->out, "  ---\n  message: ");
+    writer_json(r->out, failure_of(tc)->reason);
+    if (failure_of(tc)->fname != NULL) {
+        lcut_writer_printf(r->out, "\n  file: ");
+        writer_json(r->out, failure_of(tc)->fname);
+        lcut_writer_printf(r->out, "\n  line: %d\n  function: ", failure_of(tc)->line);
+        writer_json(r->out, failure_of(tc)->fcname);
+    }
+    if (failure_of(tc)->detail != NULL) {
+        lcut_writer_printf(r->out, "\n  detail: ");
+        writer_json(r->out, failure_of(tc)->detail);
+    }
+    lcut_writer_printf(r->out, "\n  ...\n");
+}
+
+static void tap_run_end(lcut_reporter_t *r, lcut_test_t *test) {
+    lcut_builtin_t  *b  = r->data;
+
+    lcut_writer_printf(r->out, "1..%d\n", b->cases);
+    if (test->skipped_cases > 0) {
+        lcut_writer_printf(r->out, "# %d cases skipped, stopped after %d failed cases\n",
+                           test->skipped_cases, b->failed);
+    }
+}
+
+static void json_run_start(lcut_reporter_t *r, lcut_test_t *test) {
+    lcut_writer_printf(r->out, "{\"event\": \"run_start\", \"test\": ");
+    writer_json(r->out, test->desc);
+    lcut_writer_printf(r->out, "}\n");
+}
+
+static void json_suite_start(lcut_reporter_t *r, lcut_ts_t *ts) {
+    lcut_builtin_t  *b  = r->data;
+
+    b->tests    = 0;
+    b->failures = 0;
+    b->ns       = 0;
+    lcut_writer_printf(r->out, "{\"event\": \"suite_start\", \"suite\": ");
+    writer_json(r->out, ts->desc);
+    lcut_writer_printf(r->out, "}\n");
+}
+
+static void json_case_end(lcut_reporter_t *r, const lcut_case_report_t *report) {
+    lcut_builtin_t  *b  = r->data;
+    lcut_tc_t       *tc = report->tc;
+
+    builtin_case_counted(b, report);
+
+    lcut_writer_printf(r->out, "{\"event\": \"case\", \"suite\": ");
+    writer_json(r->out, report->ts->desc);
+    lcut_writer_printf(r->out, ", \"case\": ");
+    writer_json(r->out, tc->desc);
+    lcut_writer_printf(r->out, ", \"status\": \"%s\", \"elapsed_ms\": %.3f, \"wall_ms\": %.3f, "
+                       "\"cpu_ms\": %.3f, \"assertions\": %lld, \"slow\": %s, \"flaky\": %s",
+                       tc->status == TEST_CASE_FAILURE ? "failed" : "passed", report->elapsed_ns / 1e6,
+                       tc->wall_ns / 1e6, tc->cpu_ns / 1e6, tc->asserts,
+                       report->slow ? "true" : "false", report->flaky ? "true" : "false");
+    if (tc->allocs.count > 0) {
+        lcut_writer_printf(r->out, ", \"allocs\": %lld, \"alloc_bytes\": %lld, \"leaks\": %lld",
+                           tc->allocs.count, tc->allocs.bytes, tc->allocs.leaks);
+    }
+    if (tc->bench != NULL && tc->bench->samples > 0) {
+        lcut_writer_printf(r->out, ", \"median_ns\": %.3f", tc->bench->median_ns);
+    }
+    if (tc->status == TEST_CASE_FAILURE) {
+        if (failure_of(tc)->fname != NULL) {
+            lcut_writer_printf(r->out, ", \"file\": ");
+            writer_json(r->out, failure_of(tc)->fname);
+            lcut_writer_printf(r->out, ", \"line\": %d, \"function\": ", failure_of(tc)->line);
+            writer_json(r->out, failure_of(tc)->fcname);
+        }
+        lcut_writer_printf(r->out, ", \"reason\": ");
+        writer_json(r->out, failure_of(tc)->reason);
+        if (failure_of(tc)->detail != NULL) {
+            lcut_writer_printf(r->out, ", \"detail\": ");
+            writer_json(r->out, failure_of(tc)->detail);
+        }
+    }
+    lcut_writer_printf(r->out, "}\n");
+}
+
+static void json_suite_end(lcut_reporter_t *r, lcut_ts_t *ts) {
+    lcut_builtin_t  *b  = r->data;
+
+    lcut_writer_printf(r->out, "{\"event\": \"suite_end\", \"suite\": ");
+    writer_json(r->out, ts->desc);
+    lcut_writer_printf(r->out, ", \"cases\": %d, \"failed\": %d, \"elapsed_ms\": %.3f}\n",
+                       b->tests, b->failures, b->ns / 1e6);
+}
+
+static void json_run_end(lcut_reporter_t *r, lcut_test_t *test) {
+    lcut_builtin_t  *b  = r->data;
+
+    lcut_writer_printf(r->out, "{\"event\": \"run_end\", \"cases\": %d, \"failed\": %d, "
+                       "\"skipped\": %d, \"wall_ms\": %.3f}\n",
+                       b->cases, b->failed, test->skipped_cases, test->wall_ns / 1e6);
+}
+
+static const lcut_reporter_t _console_reporter = {
+    console_run_start, console_suite_start, NULL, console_case_end, NULL, NULL, builtin_destroy
+};
+
+static const lcut_reporter_t _junit_reporter = {
+    junit_run_start, junit_suite_start, NULL, junit_case_end, junit_suite_end, junit_run_end, builtin_destroy
+};
+
+static const lcut_reporter_t _tap_reporter = {
+    tap_run_start, tap_suite_start, NULL, tap_case_end, NULL, tap_run_end, builtin_destroy
+};
+
+static const lcut_reporter_t _json_reporter = {
+    json_run_start, json_suite_start, NULL, json_case_end, json_suite_end, json_run_end, builtin_destroy
+};
+
+int lcut_test_add_reporter(lcut_test_t *test, lcut_reporter_t *r, const char *path) {
+    lcut_reporter_t **p = &(test->reporters);
+    int             rv  = 0;
+
+    r->out  = NULL;
+    r->next = NULL;
+    if (path != NULL && (r->out = writer_open(path)) == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: can't open the report file <%s>, errcode[%d]\n", path, rv);
+        return rv;
+    }
+
+    while ((*p) != NULL) {
+        p = &((*p)->next);
+    }
+    (*p) = r;
+
+    return rv;
+}
+
+static int builtin_add(lcut_test_t *test, const lcut_reporter_t *proto, const char *path) {
+    lcut_builtin_t  *b  = NULL;
+    int             rv  = 0;
+
+    if ((b = calloc(1, sizeof(*b))) == NULL) {
+        rv = errno;
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", rv);
+        return rv;
+    }
+    b->r      = (*proto);
+    b->r.data = b;
+    b->test   = test;
+
+    if ((rv = lcut_test_add_reporter(test, &(b->r), path)) != 0) {
+        free(b);
+    }
+
+    return rv;
+}
+
+/*
+ * add the reporters of the options once, the console has the stdout
+ * unless one of them took it
+ */
+static int test_reporters(lcut_test_t *test) {
+    lcut_reporter_t *r  = NULL;
+    int             rv  = 0;
+
+    for (r = test->reporters; r != NULL; r = r->next) {
+        if (r->destroy == builtin_destroy) {
+            return 0;
+        }
+    }
+
+    test->console = !(test->junit != NULL && !strcmp(test->junit, "-"))
+                    && !(test->tap != NULL && !strcmp(test->tap, "-"))
+                    && !(test->json != NULL && !strcmp(test->json, "-"));
+
+    if (test->console) {
+        rv = builtin_add(test, &_console_reporter, "-");
+    }
+    if (rv == 0 && test->junit != NULL) {
+        rv = builtin_add(test, &_junit_reporter, test->junit);
+    }
+    if (rv == 0 && test->tap != NULL) {
+        rv = builtin_add(test, &_tap_reporter, test->tap);
+    }
+    if (rv == 0 && test->json != NULL) {
+        rv = builtin_add(test, &_json_reporter, test->json);
+    }
+
+    return rv;
+}
+
+static void report_run_start(lcut_test_t *test) {
+    lcut_reporter_t *r  = NULL;
+
+    for (r = test->reporters; r != NULL; r = r->next) {
+        if (r->run_start != NULL) {
+            r->run_start(r, test);
+        }
+    }
+}
+
+/*
+ * end the suite started last, if any, and start suite i
+ */
+static void report_suite(lcut_plan_t *plan, int i) {
+    lcut_reporter_t *r  = NULL;
+
+    if (plan->open_suite > 0) {
+        for (r = plan->reporters; r != NULL; r = r->next) {
+            if (r->suite_end != NULL) {
+                r->suite_end(r, plan->suites[plan->open_suite - 1].ts);
+            }
+        }
+        plan->open_suite = 0;
+    }
+
+    if (i < 0) {
+        return;
+    }
+
+    for (r = plan->reporters; r != NULL; r = r->next) {
+        if (r->suite_start != NULL) {
+            r->suite_start(r, plan->suites[i].ts);
+        }
+    }
+    plan->open_suite = i + 1;
+    plan->next_suite = i + 1;
+}
+
+static void report_run_end(lcut_test_t *test, lcut_plan_t *plan) {
+    lcut_reporter_t *r  = NULL;
+
+    report_suite(plan, -1);
+    for (r = test->reporters; r != NULL; r = r->next) {
+        if (r->run_end != NULL) {
+            r->run_end(r, test);
+        }
+    }
+    for (r = test->reporters; r != NULL; r = r->next) {
+        lcut_writer_flush(r->out);
+    }
+}
+
+/*
+ * the serial runner starts a case before running it, the others when
+ * its result is reported
+ */
+static void report_case_start(lcut_plan_t *plan, lcut_plan_tc_t *c) {
+    lcut_reporter_t *r  = NULL;
+
+    c->started = 1;
+    for (r = plan->reporters; r != NULL; r = r->next) {
+        if (r->case_start != NULL) {
+            r->case_start(r, plan->suites[c->suite].ts, c->tc);
+        }
+    }
+}
+
+static void report_case(lcut_plan_t *plan, lcut_plan_tc_t *c, int *result) {
+    lcut_case_report_t  report;
+    lcut_reporter_t     *r  = NULL;
+
+    if (!c->started) {
+        report_case_start(plan, c);
+    }
+
+    memset(&report, 0, sizeof(report));
+    report.ts           = plan->suites[c->suite].ts;
+    report.tc           = c->tc;
+    report.index        = plan->reported++;
+    report.slow         = c->tc->status == TEST_CASE_SUCCESS && plan->slow_ms > 0
+                          && c->elapsed_ns > (long long)plan->slow_ms * 1000000LL;
+    report.flaky        = c->flaky;
+    report.runs         = c->runs + 1 < LCUT_HISTORY_WINDOW ? c->runs + 1 : LCUT_HISTORY_WINDOW;
+    report.elapsed_ns   = c->elapsed_ns;
+    report.baseline_ns  = c->base != NULL && c->base->median_ns > 0 ? c->base->median_ns : 0;
+
+    for (r = plan->reporters; r != NULL; r = r->next) {
+        if (r->case_end != NULL) {
+            r->case_end(r, &report);
+        }
+        if (r->out != NULL && r->out->live) {
+            lcut_writer_flush(r->out);
+        }
+    }
+
+    if (plan->results != NULL) {
+        results_write(plan, c);
+    }
+
+    if (c->tc->status == TEST_CASE_FAILURE) {
+        (*result) = TEST_CASE_FAILURE;
+    }
+    row_close(c, 1);
+}
+
+/*
+ * report the results in ring order, as far as they are available
+ */
+static void report_ready(lcut_plan_t *plan, int *result) {
+    lcut_plan_tc_t  *c  = NULL;
+
+    while (plan->next_case < plan->ncases) {
+        c = &(plan->cases[plan->next_case]);
+        if (!c->done) {
+            break;
+        }
+
+        if (c->skipped) {
+            plan->next_case++;
+            continue;
+        }
+
+        while (plan->next_suite <= c->suite) {
+            report_suite(plan, plan->next_suite);
+        }
+
+        report_case(plan, c, result);
+        plan->next_case++;
+    }
+
+    if (plan->next_case == plan->ncases && plan->skipped == 0) {
+        while (plan->next_suite < plan->nsuites) {
+            report_suite(plan, plan->next_suite);
+        }
+    }
+}
+
+static void run_serial(lcut_plan_t *plan, int *result) {
+    lcut_plan_ts_t      *s  = NULL;
+    struct sigaction    sa, old_sa;
+    int                 i, j;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_timeout;
+    sigaction(SIGALRM, &sa, &old_sa);
+
+    for (i = 0; i < plan->nsuites; i++) {
+        s = &(plan->suites[i]);
+        if (plan_stopped(plan)) {
+            for (j = s->first; j < s->first + s->count; j++) {
+                skip_case(plan, &(plan->cases[j]));
+            }
+            continue;
+        }
+
+        report_suite(plan, i);
+
+        suite_setup(s->ts);
+
+        for (j = s->first; j < s->first + s->count; j++) {
+            if (plan_stopped(plan)) {
+                skip_case(plan, &(plan->cases[j]));
+                continue;
+            }
+            row_open(plan, &(plan->cases[j]));
+            report_case_start(plan, &(plan->cases[j]));
+            run_case_watched(&(plan->cases[j]));
+            finish_case(plan, &(plan->cases[j]));
+            plan->cases[j].done = 1;
+            report_ready(plan, result);
+        }
+
+        suite_teardown(s->ts);
+    }
+
+    sigaction(SIGALRM, &old_sa, NULL);
+}
+
+/*
+ * longest processing time first: deal the cases, longest first,
+ * to the worker with the least estimated load
+ */
+static int sched_init(lcut_sched_t *sched, lcut_plan_t *plan, int nworkers) {
+    lcut_sched_item_t   *sorted = NULL;
+    int                 *owner  = NULL;
+    long long           known   = 0;
+    long long           mean    = 0;
+    int                 i, q, best;
+
+    memset(sched, 0, sizeof(*sched));
+    sched->plan = plan;
+    sched->left = plan->ncases;
+
+    if (plan->nestimated == 0 || nworkers <= 1) {
+        return 0;
+    }
+
+    sorted         = calloc(plan->ncases + 1, sizeof(lcut_sched_item_t));
+    owner          = calloc(plan->ncases + 1, sizeof(int));
+    sched->items   = calloc(plan->ncases + 1, sizeof(int));
+    sched->queues  = calloc(nworkers, sizeof(lcut_queue_t));
+    if (sorted == NULL || owner == NULL || sched->items == NULL || sched->queues == NULL) {
+        free(sorted);
+        free(owner);
+        free(sched->items);
+        free(sched->queues);
+        sched->items  = NULL;
+        sched->queues = NULL;
+        return 0;
+    }
+
+    /* the cases without history are assumed to be average */
+    for (i = 0; i < plan->ncases; i++) {
+        if (plan->cases[i].est_ns >= 0) {
+            known += plan->cases[i].est_ns;
+        }
+    }
+    mean = known / plan->nestimated;
+
+    for (i = 0; i < plan->ncases; i++) {
+        sorted[i].idx    = i;
+        sorted[i].first  = plan->cases[i].runs > 0 && (plan->cases[i].history & 1);
+        sorted[i].est_ns = plan->cases[i].est_ns >= 0 ? plan->cases[i].est_ns : mean;
+    }
+    qsort(sorted, plan->ncases, sizeof(lcut_sched_item_t), sched_item_cmp);
+
+    sched->nqueues = nworkers;
+    for (i = 0; i < plan->ncases; i++) {
+        best = 0;
+        for (q = 1; q < nworkers; q++) {
+            if (sched->queues[q].load < sched->queues[best].load) {
+                best = q;
+            }
+        }
+        owner[i] = best;
+        sched->queues[best].load += sorted[i].est_ns;
+        sched->queues[best].tail++;
+    }
+
+    for (q = 0, i = 0; q < nworkers; q++) {
+        sched->queues[q].head = i;
+        i += sched->queues[q].tail;
+        sched->queues[q].tail = sched->queues[q].head;
+        pthread_mutex_init(&(sched->queues[q].lock), NULL);
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        q = owner[i];
+        sched->items[sched->queues[q].tail++] = sorted[i].idx;
+        plan->cases[sorted[i].idx].est_ns = sorted[i].est_ns;
+    }
+
+    free(sorted);
+    free(owner);
+
+    return 0;
+}
+
+static void sched_destroy(lcut_sched_t *sched) {
+    int q;
+
+    for (q = 0; q < sched->nqueues; q++) {
+        pthread_mutex_destroy(&(sched->queues[q].lock));
+    }
+    free(sched->queues);
+    free(sched->items);
+    memset(sched, 0, sizeof(*sched));
+}
+
+static int sched_pop(lcut_sched_t *sched, int q, int steal) {
+    lcut_queue_t    *queue  = &(sched->queues[q]);
+    int             idx     = -1;
+
+    pthread_mutex_lock(&(queue->lock));
+    if (queue->head < queue->tail) {
+        idx = steal ? sched->items[--queue->tail] : sched->items[queue->head++];
+        queue->load -= sched->plan->cases[idx].est_ns;
+    }
+    pthread_mutex_unlock(&(queue->lock));
+
+    return idx;
+}
+
+static int sched_take(lcut_sched_t *sched, int w) {
+    int         idx = -1;
+    int         q, victim;
+    long long   load;
+
+    if (sched->nqueues == 0) {
+        idx = __sync_fetch_and_add(&(sched->next), 1);
+        if (idx >= sched->plan->ncases) {
+            return -1;
+        }
+        ATOMIC_DEC(&(sched->left));
+        return idx;
+    }
+
+    idx = sched_pop(sched, w % sched->nqueues, 0);
+    while (idx < 0) {
+        victim = -1;
+        load   = -1;
+        for (q = 0; q < sched->nqueues; q++) {
+            if (sched->queues[q].head < sched->queues[q].tail && sched->queues[q].load > load) {
+                victim = q;
+                load   = sched->queues[q].load;
+            }
+        }
+        if (victim < 0) {
+            return -1;
+        }
+        idx = sched_pop(sched, victim, 1);
+    }
+
+    ATOMIC_DEC(&(sched->left));
+    return idx;
+}
+
+/*
+ * the next case for the worker w, -1 when all the cases are handed over,
+ * once the run stopped the cases left are all handed over as skipped
+ */
+static int sched_next(lcut_sched_t *sched, int w) {
+    int idx;
+
+    if (!plan_stopped(sched->plan)) {
+        return sched_take(sched, w);
+    }
+
+    while ((idx = sched_take(sched, w)) >= 0) {
+        skip_case(sched->plan, &(sched->plan->cases[idx]));
+    }
+
+    return -1;
+}
+
+static ssize_t read_full(int fd, void *buf, size_t len) {
+    size_t  n = 0;
+    ssize_t r;
+
+    while (n < len) {
+        r = read(fd, (char*)buf + n, len - n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            break;
+        }
+        n += r;
+    }
+
+    return n;
+}
+
+static ssize_t write_full(int fd, const void *buf, size_t len) {
+    size_t  n = 0;
+    ssize_t r;
+
+    while (n < len) {
+        r = write(fd, (const char*)buf + n, len - n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            break;
+        }
+        n += r;
+    }
+
+    return n;
+}
+
+/*
+ * the body of a worker process: run the cases the parent hands over,
+ * switching the suite fixtures whenever the suite changes
+ */
+static void worker_main(lcut_plan_t *plan, int cmd_fd, int res_fd) {
+    lcut_ts_t           *cur    = NULL;
+    lcut_ts_t           *ts     = NULL;
+    lcut_tc_t           *tc     = NULL;
+    lcut_result_msg_t   msg;
+    int                 cur_suite   = -1;
+    int                 idx;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.teardown_suite = -1;
+    while (read_full(cmd_fd, &idx, sizeof(idx)) == sizeof(idx) && idx >= 0) {
+        ts = plan->suites[plan->cases[idx].suite].ts;
+        tc = row_open(plan, &(plan->cases[idx]));
+
+        if (ts != cur) {
+            if (cur != NULL) {
+                msg.teardown_ns    = suite_teardown(cur);
+                msg.teardown_suite = cur_suite;
+            }
+            cur       = ts;
+            cur_suite = plan->cases[idx].suite;
+            msg.setup_ns = suite_setup(cur);
+        }
+
+        run_case(&(plan->cases[idx]));
+
+        msg.index      = idx;
+        msg.status     = tc->status;
+        msg.elapsed_ns = plan->cases[idx].elapsed_ns;
+        msg.wall_ns    = tc->wall_ns;
+        msg.cpu_ns     = tc->cpu_ns;
+        msg.fixture_ns = tc->fixture_ns;
+        msg.allocs     = tc->allocs;
+        msg.asserts    = tc->asserts;
+        if (tc->perf != NULL) {
+            msg.perf = (*tc->perf);
+        }
+        if (tc->bench != NULL) {
+            msg.bench = (*tc->bench);
+        }
+        if (tc->status == TEST_CASE_FAILURE) {
+            msg.line = failure_of(tc)->line;
+            if (failure_of(tc)->fname != NULL) {
+                snprintf(msg.fname, LCUT_MAX_NAME_LEN, "%s", failure_of(tc)->fname);
+                snprintf(msg.fcname, LCUT_MAX_NAME_LEN, "%s", failure_of(tc)->fcname);
+            }
+            memcpy(msg.reason, failure_of(tc)->reason, LCUT_MAX_STR_LEN);
+            if (failure_of(tc)->detail != NULL) {
+                snprintf(msg.detail, LCUT_MAX_DETAIL_LEN, "%s", failure_of(tc)->detail);
+            }
+        }
+
+        fflush(stdout);
+        if (write_full(res_fd, &msg, sizeof(msg)) != sizeof(msg)) {
+            break;
+        }
+        row_close(&(plan->cases[idx]), 0);
+        memset(&msg, 0, sizeof(msg));
+        msg.teardown_suite = -1;
+    }
+
+    /* the last teardown goes back with no case */
+    memset(&msg, 0, sizeof(msg));
+    msg.index          = -1;
+    msg.teardown_suite = -1;
+    if (cur != NULL) {
+        msg.teardown_ns    = suite_teardown(cur);
+        msg.teardown_suite = cur_suite;
+    }
+
+    fflush(stdout);
+    write_full(res_fd, &msg, sizeof(msg));
+    _exit(0);
+}
+
+static int worker_spawn(lcut_plan_t *plan, lcut_worker_t *workers, int nworkers, int w) {
+    int     cmd[2];
+    int     res[2];
+    int     i;
+    pid_t   pid;
+
+    if (pipe(cmd) != 0) {
+        return errno;
+    }
+    if (pipe(res) != 0) {
+        close(cmd[0]);
+        close(cmd[1]);
+        return errno;
+    }
+
+    fflush(stdout);
+    if (plan->results != NULL) {
+        fflush(plan->results);
+    }
+    pid = fork();
+    if (pid < 0) {
+        close(cmd[0]);
+        close(cmd[1]);
+        close(res[0]);
+        close(res[1]);
+        return errno;
+    }
+
+    if (pid == 0) {
+        for (i = 0; i < nworkers; i++) {
+            if (workers[i].pid > 0) {
+                close(workers[i].cmd_fd);
+                close(workers[i].res_fd);
+            }
+        }
+        close(cmd[1]);
+        close(res[0]);
+        worker_main(plan, cmd[0], res[1]);
+    }
+
+    close(cmd[0]);
+    close(res[1]);
+    workers[w].pid    = pid;
+    workers[w].cmd_fd = cmd[1];
+    workers[w].res_fd = res[0];
+    workers[w].busy   = -1;
+
+    return 0;
+}
+
+/*
+ * a retired worker keeps no fd and no pid, waitpid(0) would reap any child
+ */
+static void worker_retire(lcut_worker_t *worker, int *status) {
+    if (worker->pid <= 0) {
+        return;
+    }
+
+    close(worker->cmd_fd);
+    close(worker->res_fd);
+    while (waitpid(worker->pid, status, 0) < 0 && errno == EINTR) {
+        ;
+    }
+    worker->pid    = 0;
+    worker->busy   = -1;
+    worker->cmd_fd = -1;
+    worker->res_fd = -1;
+}
+
+/*
+ * hand the next case over to an idle worker, or let it quit
+ */
+static void worker_dispatch(lcut_worker_t *worker, lcut_sched_t *sched, int w) {
+    int idx = sched_next(sched, w);
+    int ms  = idx >= 0 ? sched->plan->cases[idx].timeout_ms : 0;
+
+    worker->busy     = idx;
+    worker->deadline = ms > 0 ? now_ns() + (long long)ms * 1000000LL : 0;
+    write_full(worker->cmd_fd, &idx, sizeof(idx));
+}
+
+/*
+ * milliseconds to wait for the nearest deadline of the workers, -1: forever
+ */
+static int worker_wait_ms(lcut_worker_t *workers, int nworkers) {
+    long long   nearest = 0;
+    long long   now     = now_ns();
+    int         w;
+
+    for (w = 0; w < nworkers; w++) {
+        if (workers[w].pid > 0 && workers[w].busy >= 0 && workers[w].deadline > 0
+            && (nearest == 0 || workers[w].deadline < nearest)) {
+            nearest = workers[w].deadline;
+        }
+    }
+
+    if (nearest == 0) {
+        return -1;
+    }
+
+    return nearest <= now ? 0 : (int)((nearest - now + 999999LL) / 1000000LL);
+}
+
+static void worker_crashed(lcut_tc_t *tc, int status) {
+    if (WIFSIGNALED(status)) {
+        FILL_IN_FAILED_REASON(tc, NULL, NULL, 0,
+                              "worker process killed by signal %d (%s)",
+                              WTERMSIG(status), strsignal(WTERMSIG(status)));
+    } else {
+        FILL_IN_FAILED_REASON(tc, NULL, NULL, 0,
+                              "worker process exited with code %d",
+                              WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    }
+}
+
+/*
+ * account the suite fixtures a worker ran to the suites of the parent
+ */
+static void worker_fixtures(lcut_plan_t *plan, lcut_result_msg_t *msg) {
+    if (msg->index >= 0) {
+        plan->suites[plan->cases[msg->index].suite].ts->setup_ns += msg->setup_ns;
+    }
+    if (msg->teardown_suite >= 0) {
+        plan->suites[msg->teardown_suite].ts->teardown_ns += msg->teardown_ns;
+    }
+}
+
+static void run_forked(lcut_plan_t *plan, lcut_sched_t *sched, int jobs, int *result) {
+    lcut_worker_t       *workers    = NULL;
+    struct pollfd       *fds        = NULL;
+    int                 *owner      = NULL;
+    lcut_result_msg_t   msg;
+    lcut_tc_t           *tc         = NULL;
+    struct sigaction    sa, old_sa;
+    int                 nworkers    = 0;
+    int                 inflight    = 0;
+    int                 nfds, status, i, w, k;
+
+    workers = calloc(jobs, sizeof(lcut_worker_t));
+    fds     = calloc(jobs, sizeof(struct pollfd));
+    owner   = calloc(jobs, sizeof(int));
+    if (workers == NULL || fds == NULL || owner == NULL) {
+        free(workers);
+        free(fds);
+        free(owner);
+        run_serial(plan, result);
+        return;
+    }
+
+    /* a worker may die before reading its next case */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, &old_sa);
+
+    for (w = 0; w < jobs; w++) {
+        if (worker_spawn(plan, workers, jobs, w) != 0) {
+            printf("\t[LCUT]: fork worker error!, errcode[%d]\n", errno);
+            break;
+        }
+        nworkers++;
+        worker_dispatch(&workers[w], sched, w);
+        if (workers[w].busy >= 0) {
+            inflight++;
+        }
+    }
+
+    if (nworkers == 0) {
+        sigaction(SIGPIPE, &old_sa, NULL);
+        free(workers);
+        free(fds);
+        free(owner);
+        run_serial(plan, result);
+        return;
+    }
+
+    while (inflight > 0) {
+        nfds = 0;
+        for (w = 0; w < nworkers; w++) {
+            if (workers[w].pid > 0 && workers[w].busy >= 0) {
+                fds[nfds].fd      = workers[w].res_fd;
+                fds[nfds].events  = POLLIN;
+                fds[nfds].revents = 0;
+                owner[nfds++]     = w;
+            }
+        }
+
+        if (poll(fds, nfds, worker_wait_ms(workers, nworkers)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            printf("\t[LCUT]: poll error!, errcode[%d]\n", errno);
+            exit(EXIT_FAILURE);
+        }
+
+        for (i = 0; i < nfds; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+
+            w = owner[i];
+            if (workers[w].pid <= 0 || workers[w].busy < 0) {
+                continue;
+            }
+            if (read_full(workers[w].res_fd, &msg, sizeof(msg)) == sizeof(msg)
+                && msg.index == workers[w].busy) {
+                tc = row_open(plan, &(plan->cases[msg.index]));
+                tc->status = msg.status;
+                if (msg.status == TEST_CASE_FAILURE) {
+                    fail_case_copy(tc, msg.fname, msg.fcname, msg.line, msg.reason);
+                    failure_detail(tc, msg.detail);
+                }
+                tc->wall_ns    = msg.wall_ns;
+                tc->cpu_ns     = msg.cpu_ns;
+                tc->fixture_ns = msg.fixture_ns;
+                tc->allocs     = msg.allocs;
+                tc->asserts    = msg.asserts;
+                if (tc->perf != NULL) {
+                    (*tc->perf) = msg.perf;
+                }
+                if (tc->bench != NULL) {
+                    (*tc->bench) = msg.bench;
+                }
+                worker_fixtures(plan, &msg);
+                plan->cases[msg.index].elapsed_ns = msg.elapsed_ns;
+                finish_case(plan, &(plan->cases[msg.index]));
+                plan->cases[msg.index].done = 1;
+                inflight--;
+                workers[w].busy = -1;
+                worker_dispatch(&workers[w], sched, w);
+                if (workers[w].busy >= 0) {
+                    inflight++;
+                }
+                continue;
+            }
+
+            /* the worker died in the middle of a case */
+            k  = workers[w].busy;
+            tc = row_open(plan, &(plan->cases[k]));
+            plan->cases[k].done = 1;
+            inflight--;
+            worker_retire(&workers[w], &status);
+            worker_crashed(tc, status);
+            finish_case(plan, &(plan->cases[k]));
+
+            if (sched->left > 0 && worker_spawn(plan, workers, nworkers, w) == 0) {
+                worker_dispatch(&workers[w], sched, w);
+                if (workers[w].busy >= 0) {
+                    inflight++;
+                }
+            }
+        }
+
+        /* kill the workers whose case is hanging, and replace them */
+        for (w = 0; w < nworkers; w++) {
+            if (workers[w].pid <= 0 || workers[w].busy < 0
+                || workers[w].deadline == 0 || workers[w].deadline > now_ns()) {
+                continue;
+            }
+
+            k = workers[w].busy;
+            plan->cases[k].done = 1;
+            inflight--;
+            kill(workers[w].pid, SIGKILL);
+            worker_retire(&workers[w], &status);
+            row_open(plan, &(plan->cases[k]));
+            timeout_case(&(plan->cases[k]));
+            finish_case(plan, &(plan->cases[k]));
+
+            if (sched->left > 0 && worker_spawn(plan, workers, nworkers, w) == 0) {
+                worker_dispatch(&workers[w], sched, w);
+                if (workers[w].busy >= 0) {
+                    inflight++;
+                }
+            }
+        }
+
+        report_ready(plan, result);
+    }
+
+    for (w = 0; w < nworkers; w++) {
+        if (workers[w].pid > 0) {
+            if (read_full(workers[w].res_fd, &msg, sizeof(msg)) == sizeof(msg) && msg.index < 0) {
+                worker_fixtures(plan, &msg);
+            }
+            worker_retire(&workers[w], &status);
+        }
+    }
+
+    /* no worker could be forked to run the rest */
+    while ((i = sched_next(sched, 0)) >= 0) {
+        tc = row_open(plan, &(plan->cases[i]));
+        FILL_IN_FAILED_REASON(tc, NULL, NULL, 0, "%s",
+                              "no worker process is left to run the case");
+        finish_case(plan, &(plan->cases[i]));
+        plan->cases[i].done = 1;
+    }
+    report_ready(plan, result);
+
+    sigaction(SIGPIPE, &old_sa, NULL);
+    free(workers);
+    free(fds);
+    free(owner);
+}
+
+/*
+ * run the setup of a suite once, on the first thread reaching it
+ */
+static void suite_enter(lcut_plan_ts_t *s) {
+    pthread_mutex_lock(&(s->lock));
+    if (!s->entered) {
+        suite_setup(s->ts);
+        s->entered = 1;
+    }
+    pthread_mutex_unlock(&(s->lock));
+}
+
+/*
+ * run the teardown of a suite on the thread finishing its last case
+ */
+static void suite_leave(lcut_plan_ts_t *s) {
+    if (ATOMIC_DEC(&(s->pending)) == 0) {
+        suite_teardown(s->ts);
+    }
+}
+
+/*
+ * a case with a timeout runs on a copy, its benchmark and perf state
+ * included, so that the thread may be left behind when it hangs, and
+ * touches nothing but itself once it returns
+ */
+static int thread_run_case(lcut_thread_t *self, lcut_plan_tc_t *c, int idx) {
+    lcut_pool_t     *pool   = self->pool;
+    lcut_plan_tc_t  copy    = *c;
+    lcut_tc_t       tc      = *(c->tc);
+    lcut_bench_t    bench;
+    lcut_perf_t     perf;
+
+    pthread_mutex_lock(&(pool->lock));
+    self->current = idx;
+    self->started = now_ns();
+    self->state   = THREAD_RUNNING;
+    pthread_mutex_unlock(&(pool->lock));
+
+    if (c->timeout_ms > 0) {
+        if (tc.bench != NULL) {
+            bench    = *(tc.bench);
+            tc.bench = &bench;
+        }
+        if (tc.perf != NULL) {
+            perf    = *(tc.perf);
+            tc.perf = &perf;
+        }
+        copy.tc = &tc;
+        run_case(&copy);
+    } else {
+        run_case(c);
+    }
+
+    if (!__sync_bool_compare_and_swap(&(self->state), THREAD_RUNNING, THREAD_IDLE)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&(pool->lock));
+    if (c->timeout_ms > 0) {
+        if (tc.bench != NULL) {
+            (*c->tc->bench) = bench;
+            tc.bench        = c->tc->bench;
+        }
+        if (tc.perf != NULL) {
+            (*c->tc->perf) = perf;
+            tc.perf        = c->tc->perf;
+        }
+        (*c->tc)      = tc;
+        c->elapsed_ns = copy.elapsed_ns;
+    }
+    self->current = -1;
+    pthread_mutex_unlock(&(pool->lock));
+
+    return 0;
+}
+
+static void* thread_main(void *arg) {
+    lcut_thread_t   *self   = arg;
+    lcut_pool_t     *pool   = self->pool;
+    lcut_plan_t     *plan   = pool->plan;
+    lcut_plan_tc_t  *c      = NULL;
+    lcut_plan_ts_t  *s      = NULL;
+    int             idx;
+
+    mock_init();
+
+    while ((idx = sched_next(pool->sched, self->id)) >= 0) {
+        c = &(plan->cases[idx]);
+        s = &(plan->suites[c->suite]);
+
+        suite_enter(s);
+        row_open(plan, c);
+        if (thread_run_case(self, c, idx) != 0) {
+            break;
+        }
+        finish_case(plan, c);
+        self->ran++;
+        if (c->tc->status == TEST_CASE_FAILURE) {
+            self->failed++;
+        }
+        suite_leave(s);
+
+        pthread_mutex_lock(&(pool->lock));
+        c->done = 1;
+        pool->finished++;
+        pthread_cond_signal(&(pool->cond));
+        pthread_mutex_unlock(&(pool->lock));
+    }
+
+    /* the cases may have been skipped */
+    pthread_mutex_lock(&(pool->lock));
+    pthread_cond_signal(&(pool->cond));
+    pthread_mutex_unlock(&(pool->lock));
+
+    mock_clear();
+    perf_close();
+
+    return NULL;
+}
+
+/*
+ * start a worker thread, called with the pool lock held
+ */
+static int thread_spawn(lcut_pool_t *pool, int id) {
+    lcut_thread_t   *t          = NULL;
+    lcut_thread_t   **threads   = NULL;
+    int             rv;
+
+    if (pool->nthreads == pool->capacity) {
+        threads = realloc(pool->threads, (pool->capacity * 2 + 4) * sizeof(lcut_thread_t*));
+        if (threads == NULL) {
+            return ENOMEM;
+        }
+        pool->threads  = threads;
+        pool->capacity = pool->capacity * 2 + 4;
+    }
+
+    if ((t = calloc(1, sizeof(lcut_thread_t))) == NULL) {
+        return ENOMEM;
+    }
+    t->pool    = pool;
+    t->id      = id;
+    t->current = -1;
+
+    if ((rv = pthread_create(&(t->tid), NULL, thread_main, t)) != 0) {
+        free(t);
+        return rv;
+    }
+
+    pool->threads[pool->nthreads++] = t;
+    return 0;
+}
+
+/*
+ * give up the threads whose case is hanging and start new ones instead,
+ * called with the pool lock held, returns the nearest deadline or 0
+ */
+static long long thread_watch(lcut_pool_t *pool) {
+    lcut_plan_t     *plan       = pool->plan;
+    lcut_thread_t   *t          = NULL;
+    lcut_plan_tc_t  *c          = NULL;
+    long long       nearest     = 0;
+    long long       deadline;
+    int             i, n        = pool->nthreads;
+
+    for (i = 0; i < n; i++) {
+        t = pool->threads[i];
+        if (t->state != THREAD_RUNNING || t->current < 0
+            || plan->cases[t->current].timeout_ms <= 0) {
+            continue;
+        }
+
+        c = &(plan->cases[t->current]);
+        deadline = t->started + (long long)c->timeout_ms * 1000000LL;
+        if (deadline > now_ns()) {
+            if (nearest == 0 || deadline < nearest) {
+                nearest = deadline;
+            }
+            continue;
+        }
+
+        if (!__sync_bool_compare_and_swap(&(t->state), THREAD_RUNNING, THREAD_ABANDONED)) {
+            continue;
+        }
+        pthread_detach(t->tid);
+
+        timeout_case(c);
+        finish_case(plan, c);
+        suite_leave(&(plan->suites[c->suite]));
+        c->done = 1;
+        pool->finished++;
+
+        if (pool->sched->left > 0 && thread_spawn(pool, t->id) != 0) {
+            printf("\t[LCUT]: create worker thread error!, errcode[%d]\n", errno);
+        }
+    }
+
+    return nearest;
+}
+
+static void run_threaded(lcut_plan_t *plan, lcut_sched_t *sched, int jobs, int *result) {
+    lcut_pool_t         pool;
+    pthread_condattr_t  attr;
+    struct timespec     ts;
+    long long           deadline;
+    int                 i;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.plan  = plan;
+    pool.sched = sched;
+    pthread_mutex_init(&(pool.lock), NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&(pool.cond), &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (i = 0; i < plan->nsuites; i++) {
+        plan->suites[i].pending = plan->suites[i].count;
+        pthread_mutex_init(&(plan->suites[i].lock), NULL);
+    }
+
+    pthread_mutex_lock(&(pool.lock));
+    for (i = 0; i < jobs; i++) {
+        if (thread_spawn(&pool, i) != 0) {
+            printf("\t[LCUT]: create worker thread error!, errcode[%d]\n", errno);
+            break;
+        }
+    }
+
+    if (pool.nthreads == 0) {
+        pthread_mutex_unlock(&(pool.lock));
+        pthread_cond_destroy(&(pool.cond));
+        run_serial(plan, result);
+        return;
+    }
+
+    while (pool.finished + plan->skipped < plan->ncases) {
+        report_ready(plan, result);
+        if ((deadline = thread_watch(&pool)) == 0) {
+            if (pool.finished + plan->skipped < plan->ncases) {
+                pthread_cond_wait(&(pool.cond), &(pool.lock));
+            }
+        } else {
+            ts.tv_sec  = deadline / 1000000000LL;
+            ts.tv_nsec = deadline % 1000000000LL;
+            pthread_cond_timedwait(&(pool.cond), &(pool.lock), &ts);
+        }
+    }
+    pthread_mutex_unlock(&(pool.lock));
+
+    for (i = 0; i < pool.nthreads; i++) {
+        if (pool.threads[i]->state != THREAD_ABANDONED) {
+            pthread_join(pool.threads[i]->tid, NULL);
+            if (pool.threads[i]->failed > 0) {
+                (*result) = TEST_CASE_FAILURE;
+            }
+            free(pool.threads[i]);
+        }
+    }
+
+    /* the suites whose cases were skipped in part still owe their teardown */
+    for (i = 0; i < plan->nsuites; i++) {
+        if (plan->suites[i].entered && plan->suites[i].pending > 0) {
+            suite_teardown(plan->suites[i].ts);
+        }
+    }
+    report_ready(plan, result);
+
+    /* an abandoned thread keeps its lcut_thread_t, the only thing it touches */
+    pthread_cond_destroy(&(pool.cond));
+    free(pool.threads);
+}
+
+static void write_field(FILE *fp, const char *str) {
+    fputc('\t', fp);
+    for (; *str; str++) {
+        if (*str == '\t') {
+            fputs("\\t", fp);
+        } else if (*str == '\n') {
+            fputs("\\n", fp);
+        } else if (*str == '\\') {
+            fputs("\\\\", fp);
+        } else {
+            fputc(*str, fp);
+        }
+    }
+}
+
+/*
+ * split a line of the results file into its fields in place
+ */
+static int read_fields(char *line, char **fields, int max) {
+    char    *r  = line;
+    char    *w  = line;
+    int     n   = 0;
+
+    fields[n++] = w;
+    for (; *r && *r != '\n'; r++) {
+        if (*r == '\t') {
+            (*w++) = '\0';
+            if (n == max) {
+                return n;
+            }
+            fields[n++] = w;
+        } else if (*r == '\\' && r[1] != '\0') {
+            r++;
+            (*w++) = (*r == 't') ? '\t' : ((*r == 'n') ? '\n' : *r);
+        } else {
+            (*w++) = *r;
+        }
+    }
+    (*w) = '\0';
+
+    return n;
+}
+
+/*
+ * the results file has a "lcut-results 1" header line, a shard line and
+ * one line per case, the fields being separated by tabs:
+ *
+ * case key status elapsed_ns wall_ns cpu_ns fixture_ns line suite case
+ *      file function reason
+ *
+ * the case lines are written as the cases are reported
+ */
+static void plan_open_results(lcut_test_t *test, lcut_plan_t *plan, const char *path) {
+    if ((plan->results = fopen(path, "w")) == NULL) {
+        printf("\t[LCUT]: can't write the results file <%s>, errcode[%d]\n", path, errno);
+        return;
+    }
+
+    fprintf(plan->results, "lcut-results 1\n");
+    fprintf(plan->results, "shard\t%d\t%d", test->shard_count > 0 ? test->shard_index : 0,
+            test->shard_count > 0 ? test->shard_count : 1);
+    write_field(plan->results, test->desc);
+    fputc('\n', plan->results);
+}
+
+/*
+ * the line of a case, written when it is reported
+ */
+static void results_write(lcut_plan_t *plan, lcut_plan_tc_t *c) {
+    FILE    *fp = plan->results;
+
+    fprintf(fp, "case\t%016llx\t%d\t%lld\t%lld\t%lld\t%lld\t%d", c->key, c->tc->status,
+            c->elapsed_ns, c->tc->wall_ns, c->tc->cpu_ns, c->tc->fixture_ns,
+            c->tc->status == TEST_CASE_FAILURE ? failure_of(c->tc)->line : 0);
+    write_field(fp, plan->suites[c->suite].ts->desc);
+    write_field(fp, c->tc->desc);
+    write_field(fp, c->tc->status == TEST_CASE_FAILURE && failure_of(c->tc)->fname != NULL
+                    ? failure_of(c->tc)->fname : "");
+    write_field(fp, c->tc->status == TEST_CASE_FAILURE && failure_of(c->tc)->fname != NULL
+                    ? failure_of(c->tc)->fcname : "");
+    write_field(fp, c->tc->status == TEST_CASE_FAILURE ? failure_of(c->tc)->reason : "");
+    fputc('\n', fp);
+}
+
+static void plan_close_results(lcut_plan_t *plan, const char *path) {
+    if (plan->results != NULL && fclose(plan->results) != 0) {
+        printf("\t[LCUT]: can't write the results file <%s>, errcode[%d]\n", path, errno);
+    }
+    plan->results = NULL;
+}
+
+/*
+ * fill the plan with the results of the runs of the shards
+ * instead of running the cases, print what each file brings in
+ */
+static void plan_merge_results(lcut_plan_t *plan, const char *path, lcut_timings_t *index) {
+    FILE                *fp     = NULL;
+    char                *line   = NULL;
+    size_t              size    = 0;
+    char                *f[13];
+    lcut_timing_t       *slot   = NULL;
+    lcut_plan_tc_t      *c      = NULL;
+    int                 shard   = 0;
+    int                 shards  = 1;
+    int                 cases   = 0;
+    int                 failed  = 0;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+        printf("\t[LCUT]: can't read the results file <%s>, errcode[%d]\n", path, errno);
+        return;
+    }
+
+    while (getline(&line, &size, fp) > 0) {
+        if (read_fields(line, f, 13) == 13 && !strcmp(f[0], "case")) {
+            slot = timings_slot(index, strtoull(f[1], NULL, 16));
+            if (slot->key == 0) {
+                continue;
+            }
+            c = &(plan->cases[slot->ns]);
+            row_open(plan, c);
+            c->tc->status  = atoi(f[2]);
+            c->elapsed_ns  = atoll(f[3]);
+            c->tc->wall_ns    = atoll(f[4]);
+            c->tc->cpu_ns     = atoll(f[5]);
+            c->tc->fixture_ns = atoll(f[6]);
+            if (c->tc->status == TEST_CASE_FAILURE) {
+                fail_case_copy(c->tc, f[10], f[11], atoi(f[7]), f[12]);
+            }
+            c->selected    = 1;
+            cases++;
+            if (c->tc->status == TEST_CASE_FAILURE) {
+                failed++;
+            }
+        } else if (!strcmp(f[0], "shard")) {
+            shard  = atoi(f[1]);
+            shards = atoi(f[2]);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+
+    lcut_writer_printf(plan->notes, "\tShard %d/%d: %d cases, %d failed, from <%s>\n",
+                       shard, shards, cases, failed, path);
+}
+
+static void run_merged(lcut_test_t *test, lcut_plan_t *plan, int *result) {
+    lcut_timings_t  index;
+    lcut_timing_t   *slot   = NULL;
+    int             i;
+
+    if (timings_init(&index, plan->ncases) != 0) {
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        (*result) = TEST_CASE_FAILURE;
+        return;
+    }
+
+    /* key -> index of the case in the plan */
+    for (i = 0; i < plan->ncases; i++) {
+        plan->cases[i].selected = 0;
+        if ((slot = timings_put(&index, plan->cases[i].key)) != NULL) {
+            slot->ns = i;
+        }
+    }
+
+    for (i = 0; i < test->nmerge; i++) {
+        plan_merge_results(plan, test->merge[i], &index);
+    }
+    lcut_writer_printf(plan->notes, "\n");
+    free(index.slots);
+
+    plan_compact(plan);
+    for (i = 0; i < plan->ncases; i++) {
+        finish_case(plan, &(plan->cases[i]));
+        plan->cases[i].done = 1;
+    }
+    report_ready(plan, result);
+}
+
+static void csv_field(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (; *str; str++) {
+        if (*str == '"') {
+            fputc('"', fp);
+        }
+        fputc(*str, fp);
+    }
+    fputs("\",", fp);
+}
+
+static void csv_row(FILE *fp, const char *suite, const char *name,
+                    unsigned long long key, lcut_bench_t *b) {
+    csv_field(fp, suite);
+    csv_field(fp, name);
+    fprintf(fp, "%016llx,%d,%lld,%.3f,%.3f,%.3f,%.3f,%.3f", key, b->samples, b->iters,
+            b->min_ns, b->median_ns, b->mean_ns, b->p99_ns, b->stddev_ns);
+}
+
+#define LCUT_CSV_HEADER "suite,case,key,samples,iters,min_ns,median_ns,mean_ns,p99_ns,stddev_ns"
+
+/*
+ * split a csv line into its fields in place, the quotes are removed
+ */
+static int csv_fields(char *line, char **fields, int max) {
+    char    *r      = line;
+    char    *w      = line;
+    int     n       = 0;
+    int     quoted  = 0;
+
+    fields[n++] = w;
+    for (; *r && *r != '\n' && *r != '\r'; r++) {
+        if (*r == '"' && quoted && r[1] == '"') {
+            (*w++) = *(++r);
+        } else if (*r == '"') {
+            quoted = !quoted;
+        } else if (*r == ',' && !quoted) {
+            (*w++) = '\0';
+            if (n == max) {
+                return n;
+            }
+            fields[n++] = w;
+        } else {
+            (*w++) = *r;
+        }
+    }
+    (*w) = '\0';
+
+    return n;
+}
+
+static void json_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            fprintf(fp, "\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*str);
+        } else {
+            fputc(*str, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/*
+ * the benchmark results go to FILE.csv as csv, or to FILE as json
+ */
+static void plan_save_benches(lcut_test_t *test, lcut_plan_t *plan, const char *path) {
+    FILE            *fp     = NULL;
+    lcut_plan_tc_t  *c      = NULL;
+    lcut_bench_t    *b      = NULL;
+    size_t          len     = strlen(path);
+    int             csv     = len > 4 && !strcmp(path + len - 4, ".csv");
+    int             first   = 1;
+    int             i;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+        printf("\t[LCUT]: can't write the benchmark file <%s>, errcode[%d]\n", path, errno);
+        return;
+    }
+
+    if (csv) {
+        fprintf(fp, "%s,status,baseline_median_ns\n", LCUT_CSV_HEADER);
+    } else {
+        fprintf(fp, "{\"test\": ");
+        json_string(fp, test->desc);
+        fprintf(fp, ", \"benchmarks\": [");
+    }
+
+    for (i = 0; i < plan->ncases; i++) {
+        c = &(plan->cases[i]);
+        if ((b = c->tc->bench) == NULL || !c->done || c->skipped) {
+            continue;
+        }
+
+        if (csv) {
+            csv_row(fp, plan->suites[c->suite].ts->desc, c->tc->desc, c->key, b);
+            fprintf(fp, ",%s,", c->tc->status == TEST_CASE_SUCCESS ? "passed" : "failed");
+            if (c->base != NULL) {
+                fprintf(fp, "%.3f", c->base->median_ns);
+            }
+            fputc('\n', fp);
+            continue;
+        }
+
+        fprintf(fp, "%s\n  {\"suite\": ", first ? "" : ",");
+        json_string(fp, plan->suites[c->suite].ts->desc);
+        fprintf(fp, ", \"case\": ");
+        json_string(fp, c->tc->desc);
+        fprintf(fp, ", \"key\": \"%016llx\", \"samples\": %d, \"iters\": %lld, "
+                "\"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f, "
+                "\"p99_ns\": %.3f, \"stddev_ns\": %.3f, \"status\": \"%s\"",
+                c->key, b->samples, b->iters, b->min_ns, b->median_ns, b->mean_ns,
+                b->p99_ns, b->stddev_ns, c->tc->status == TEST_CASE_SUCCESS ? "passed" : "failed");
+        if (c->base != NULL) {
+            fprintf(fp, ", \"baseline_median_ns\": %.3f", c->base->median_ns);
+        }
+        fprintf(fp, "}");
+        first = 0;
+    }
+
+    if (!csv) {
+        fprintf(fp, "\n]}\n");
+    }
+
+    if (fclose(fp) != 0) {
+        printf("\t[LCUT]: can't write the benchmark file <%s>, errcode[%d]\n", path, errno);
+    }
+}
+
+/*
+ * the baseline file is in the csv format of plan_save_benches
+ */
+static void plan_load_baseline(lcut_plan_t *plan, const char *path, lcut_baselines_t *bl) {
+    FILE            *fp     = NULL;
+    char            *line   = NULL;
+    size_t          size    = 0;
+    char            *f[10];
+    lcut_baseline_t *items  = NULL;
+    lcut_baseline_t *item   = NULL;
+    int             cap     = 0;
+    int             i, j;
+
+    memset(bl, 0, sizeof(*bl));
+    if ((fp = fopen(path, "r")) == NULL) {
+        if (errno != ENOENT) {
+            printf("\t[LCUT]: can't read the baseline file <%s>, errcode[%d]\n", path, errno);
+        }
+        return;
+    }
+
+    while (getline(&line, &size, fp) > 0) {
+        if (csv_fields(line, f, 10) != 10 || !strcmp(f[0], "suite")) {
+            continue;
+        }
+
+        if (bl->count == cap) {
+            cap   = cap * 2 + 16;
+            items = realloc(bl->items, cap * sizeof(lcut_baseline_t));
+            if (items == NULL) {
+                break;
+            }
+            bl->items = items;
+        }
+
+        item = &(bl->items[bl->count]);
+        memset(item, 0, sizeof(*item));
+        item->suite           = strdup(f[0]);
+        item->name            = strdup(f[1]);
+        item->key             = strtoull(f[2], NULL, 16);
+        item->bench.samples   = atoi(f[3]);
+        item->bench.iters     = atoll(f[4]);
+        item->bench.min_ns    = atof(f[5]);
+        item->bench.median_ns = atof(f[6]);
+        item->bench.mean_ns   = atof(f[7]);
+        item->bench.p99_ns    = atof(f[8]);
+        item->bench.stddev_ns = atof(f[9]);
+        if (item->suite == NULL || item->name == NULL) {
+            free(item->suite);
+            free(item->name);
+            break;
+        }
+        bl->count++;
+    }
+
+    free(line);
+    fclose(fp);
+
+    /* the benchmarks are few, a scan is enough */
+    for (i = 0; i < plan->ncases; i++) {
+        if (plan->cases[i].tc->bench == NULL) {
+            continue;
+        }
+        for (j = 0; j < bl->count; j++) {
+            if (bl->items[j].key == plan->cases[i].key) {
+                plan->cases[i].base = &(bl->items[j].bench);
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * write the benchmarks of this run, and keep the others of the baseline
+ */
+static void plan_save_baseline(lcut_plan_t *plan, const char *path, lcut_baselines_t *bl) {
+    FILE            *fp = NULL;
+    lcut_plan_tc_t  *c  = NULL;
+    char            tmp[4096];
+    int             i, j;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    if ((fp = fopen(tmp, "w")) == NULL) {
+        printf("\t[LCUT]: can't write the baseline file <%s>, errcode[%d]\n", tmp, errno);
+        return;
+    }
+
+    fprintf(fp, "%s\n", LCUT_CSV_HEADER);
+    for (i = 0; i < plan->ncases; i++) {
+        c = &(plan->cases[i]);
+        if (c->tc->bench == NULL || c->tc->bench->samples == 0 || c->skipped) {
+            continue;
+        }
+        csv_row(fp, plan->suites[c->suite].ts->desc, c->tc->desc, c->key, c->tc->bench);
+        fputc('\n', fp);
+        for (j = 0; j < bl->count; j++) {
+            if (bl->items[j].key == c->key) {
+                bl->items[j].ran = 1;
+            }
+        }
+    }
+
+    for (j = 0; j < bl->count; j++) {
+        if (!bl->items[j].ran) {
+            csv_row(fp, bl->items[j].suite, bl->items[j].name, bl->items[j].key, &(bl->items[j].bench));
+            fputc('\n', fp);
+        }
+    }
+
+    if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+        printf("\t[LCUT]: can't write the baseline file <%s>, errcode[%d]\n", path, errno);
+        unlink(tmp);
+    }
+}
+
+static void baselines_free(lcut_baselines_t *bl) {
+    int i;
+
+    for (i = 0; i < bl->count; i++) {
+        free(bl->items[i].suite);
+        free(bl->items[i].name);
+    }
+    free(bl->items);
+    memset(bl, 0, sizeof(*bl));
+}
+
+void lcut_test_run(lcut_test_t *test, int *result) {
+    lcut_plan_t     plan;
+    lcut_sched_t    sched;
+    lcut_timings_t  timings;
+    int             history = 0;    /* 1: the history file is loaded */
+    lcut_baselines_t baselines;
+    long long       start   = now_ns();
+    long long       fixture;
+    int             jobs    = test->jobs;
 
-    if (condition) {
+    if (!test->list && test_reporters(test) != 0) {
+        (*result) = TEST_CASE_FAILURE;
         return;
     }
 
-    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
-                          "%s",
-                          msg);
-}
+    if (plan_build(test, &plan) != 0) {
+        (*result) = TEST_CASE_FAILURE;
+        return;
+    }
 
-void lcut_true(lcut_tc_t *tc, int condition,
-               int lineno, const char *fcname, const char *fname) {
-    RETURN_WHEN_FAILED(tc);
+    if (test->filter != NULL) {
+        plan_filter(&plan, test->filter);
+    }
 
-    if (condition) {
+    if (!test->list) {
+        plan.reporters = test->reporters;
+        plan.notes     = test->console && !test->quiet ? _stdout_writer : NULL;
+        report_run_start(test);
+    }
+
+    if (test->nmerge > 0) {
+        if (test->results != NULL) {
+            plan_open_results(test, &plan, test->results);
+        }
+        run_merged(test, &plan, result);
+        test->dropped_suites = plan.dropped_suites;
+        test->dropped_cases  = plan.dropped_cases;
+        report_run_end(test, &plan);
+        plan_close_results(&plan, test->results);
+        plan_destroy(&plan);
         return;
     }
 
-    FILL_IN_FAILED_REASON(tc, fname, fcname, lineno,
-                          "%s",
-                          "");
-}
+    memset(&timings, 0, sizeof(timings));
+    if (test->timings != NULL) {
+        plan_load_timings(&plan, test->timings, &timings);
+    }
 
-int lcut_test_init(lcut_test_t **test, const char *title, fixture_func setup, fixture_func teardown) {
-    int		        rv	= 0;
-    lcut_test_t		*p	= NULL;
+    if (test->shard_count > 1) {
+        plan_shard(&plan, test->shard_index, test->shard_count, test->shard_mode);
+    }
+    test->dropped_suites = plan.dropped_suites;
+    test->dropped_cases  = plan.dropped_cases;
 
-    p = malloc(sizeof(*p));
-    if (p == NULL) {
-        rv = errno;
-        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
-        return rv;
+    if (test->list) {
+        plan_list(&plan);
+        free(timings.slots);
+        plan_destroy(&plan);
+        return;
     }
 
-    memset(p, 0, sizeof(lcut_test_t));
-    APR_RING_INIT(&(p->ts_head), lcut_ts_t, link);
-    strncpy(p->desc, title, LCUT_MAX_NAME_LEN);
-    p->setup = setup;
-    p->teardown = teardown;
+    if (test->history != NULL) {
+        history = plan_load_history(&plan, test->history) == 0;
+    }
 
-    APR_RING_INIT(&_symbol_list, lcut_symbol_t, link);
+    if (test->results != NULL) {
+        plan_open_results(test, &plan, test->results);
+    }
 
-    (*test) = p;
+    memset(&baselines, 0, sizeof(baselines));
+    if (test->baseline != NULL) {
+        plan_load_baseline(&plan, test->baseline, &baselines);
+    }
 
-    return rv;
-}
+    if (jobs == 0) {
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (jobs > plan.ncases) {
+        jobs = plan.ncases;
+    }
 
-void lcut_test_destroy(lcut_test_t **test) {
-    lcut_test_t     *p      = (*test);
-    lcut_ts_t       *ts     = NULL;
-    lcut_tc_t       *tc     = NULL;
-    lcut_symbol_t   *s      = NULL;
-    lcut_value_t    *v      = NULL;
-
-    while (!APR_RING_EMPTY(&_symbol_list, lcut_symbol_t, link)) {
-        s = APR_RING_FIRST(&_symbol_list);
-        if (s != NULL) {
-            while (!APR_RING_EMPTY(&(s->value_list), lcut_value_t, link)) {
-                v = APR_RING_FIRST(&(s->value_list));
-                if (v != NULL) {
-                    APR_RING_REMOVE(v, link);
-                    free(v);
-                    v = NULL;
-                }
-            }
+    sched_init(&sched, &plan, jobs);
 
-            APR_RING_REMOVE(s, link);
-            free(s);
-            s = NULL;
-        }
+    /* the notes below go after the title */
+    if (test->perf) {
+        lcut_writer_flush(_stdout_writer);
     }
 
-    while (!APR_RING_EMPTY(&(p->ts_head), lcut_ts_t, link)) {
-        ts = APR_RING_FIRST(&(p->ts_head));
-        if (ts != NULL) {
-            while (!APR_RING_EMPTY(&(ts->tc_head), lcut_tc_t, link)) {
-                tc = APR_RING_FIRST(&(ts->tc_head));
-                if (tc != NULL) {
-                    APR_RING_REMOVE(tc, link);
-                    free(tc);
-                    tc = NULL;
-                }
-            }
-        }
-        APR_RING_REMOVE(ts, link);
-        free(ts);
-        ts = NULL;
+    /* the workers inherit the seed, a failed property case reports it */
+    if (test->seed == 0) {
+        test->seed = hash_mix((unsigned long long)time(NULL) ^ ((unsigned long long)getpid() << 32)
+                              ^ (unsigned long long)now_ns());
     }
+    _prop_seed = test->seed;
 
-    free(p);
-    (*test) = NULL;
-}
+    _perf_on = test->perf;
+    if (_perf_on && perf_open() == 0) {
+        printf("\t[LCUT]: no perf events can be counted, errcode[%d]\n", errno);
+        _perf_on = 0;
+    } else if (_perf_on && plan_perf(&plan) != 0) {
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        _perf_on = 0;
+    } else if (_perf_on && _perf.fds[PERF_INSTRUCTIONS] < 0 && _perf.fds[PERF_CYCLES] < 0) {
+        printf("\t[LCUT]: no hardware perf counters, counting the software events\n");
+    }
 
-int lcut_ts_init(lcut_ts_t **ts, const char *title, fixture_func setup, fixture_func teardown) {
-    int         rv = 0;
-    lcut_ts_t	*p = NULL;
+    if (test->setup != NULL) {
+        fixture = now_ns();
+        test->setup();
+        test->fixture_ns += now_ns() - fixture;
+    }
 
-    p = malloc(sizeof(lcut_ts_t));
-    if (p == NULL) {
-        rv = errno;
-        printf("\t[LCUT]: malloc error!, errcode[%d] n", errno);
-        return rv;
+    if (jobs > 1 && test->runner == LCUT_RUNNER_THREAD) {
+        run_threaded(&plan, &sched, jobs, result);
+    } else if (jobs > 1) {
+        run_forked(&plan, &sched, jobs, result);
+    } else {
+        run_serial(&plan, result);
     }
-    memset(p, 0, sizeof(lcut_ts_t));
-    APR_RING_INIT(&(p->tc_head), lcut_tc_t, link);
-    strncpy(p->desc, title, LCUT_MAX_NAME_LEN);
-    p->ran      = 0;
-    p->failed   = 0;
-    p->setup    = setup;
-    p->teardown = teardown;
 
-    (*ts) = p;
+    if (test->teardown != NULL) {
+        fixture = now_ns();
+        test->teardown();
+        test->fixture_ns += now_ns() - fixture;
+    }
+    test->wall_ns = now_ns() - start;
+    perf_close();
+    _perf_on = 0;
 
-    return rv;
-}
+    test->skipped_cases = plan.skipped;
+    report_run_end(test, &plan);
 
-void lcut_ts_add(lcut_test_t *test, lcut_ts_t *ts) {
-    lcut_ts_t	*p = ts;
+    if (test->timings != NULL) {
+        plan_save_timings(&plan, test->timings, &timings);
+    }
 
-    APR_RING_ELEM_INIT(p, link);
-    APR_RING_INSERT_TAIL(&(test->ts_head), p, lcut_ts_t, link);
-    test->suites++;
-    test->cases += p->ran;
-}
+    plan_close_results(&plan, test->results);
 
-int lcut_tc_add(lcut_ts_t *ts,
-               const char *title,
-               tc_func func,
-               void *para,
-               fixture_func before,
-               fixture_func after) {
-    int	rv	= 0;
-    lcut_tc_t	*tc 	= NULL;
+    if (history) {
+        plan_save_history(&plan, test->history);
+    }
 
-    tc = malloc(sizeof(lcut_tc_t));
-    if (tc == NULL) {
-        rv = errno;
-        printf("\t[LCUT]: malloc error!, errcode[%d] n", rv);
-        return rv;
+    if (test->bench_out != NULL) {
+        plan_save_benches(test, &plan, test->bench_out);
     }
-    memset(tc, 0, sizeof(lcut_tc_t));
 
-    strncpy(tc->desc, title, LCUT_MAX_NAME_LEN);
-    tc->func = func;
-    tc->para = para;
-    tc->before = before;
-    tc->after = after;
-    APR_RING_ELEM_INIT(tc, link);
-    APR_RING_INSERT_TAIL(&(ts->tc_head), tc, lcut_tc_t, link);
-    ts->ran++;
+    if (test->save_baseline) {
+        plan_save_baseline(&plan, test->baseline, &baselines);
+    }
+    baselines_free(&baselines);
 
-    return rv;
+    if (plan.skipped > 0) {
+        (*result) = TEST_CASE_FAILURE;
+    }
+
+    sched_destroy(&sched);
+    plan_destroy(&plan);
 }
 
-void lcut_test_run(lcut_test_t *test, int *result) {
-    lcut_ts_t	*ts	= NULL;
-    lcut_tc_t	*tc	= NULL;
+typedef struct lcut_spent_t {
+    lcut_ts_t                   *ts;
+    lcut_tc_t                   *tc;        /* NULL: the whole suite */
+    long long                   ns;
+} lcut_spent_t;
+
+/*
+ * move the n biggest to the front, biggest first
+ */
+static void spent_top(lcut_spent_t *spent, int count, int n) {
+    lcut_spent_t    tmp;
+    int             i, j, max;
 
-    printf("%s \n", LCUT_LOGO);
-    printf("Unit Test for '%s':\n\n", test->desc);
+    for (i = 0; i < n && i < count; i++) {
+        max = i;
+        for (j = i + 1; j < count; j++) {
+            if (spent[j].ns > spent[max].ns) {
+                max = j;
+            }
+        }
+        tmp         = spent[i];
+        spent[i]    = spent[max];
+        spent[max]  = tmp;
+    }
+}
 
-    if (test->setup != NULL) {
-        test->setup();
+static void report_times(lcut_test_t *test, lcut_writer_t *w) {
+    lcut_spent_t    *cases  = NULL;
+    lcut_spent_t    *suites = NULL;
+    lcut_ts_t       *ts     = NULL;
+    lcut_tc_t       *tc     = NULL;
+    long long       wall    = 0;
+    long long       cpu     = 0;
+    long long       before  = 0;
+    long long       setup   = 0;
+    int             ncases  = 0;
+    int             nsuites = 0;
+    int             i;
+
+    cases  = calloc(test->cases + 1, sizeof(lcut_spent_t));
+    suites = calloc(test->suites + 1, sizeof(lcut_spent_t));
+    if (cases == NULL || suites == NULL) {
+        free(cases);
+        free(suites);
+        return;
     }
 
     APR_RING_FOREACH(ts, &(test->ts_head), lcut_ts_t, link) {
-        if (ts != NULL) {
-            printf("\tSuite <%s>: \n", ts->desc);
-            if (ts->setup != NULL) {
-                ts->setup();
+        suites[nsuites].ts = ts;
+        suites[nsuites].ns = ts->setup_ns + ts->teardown_ns;
+        setup += ts->setup_ns + ts->teardown_ns;
+
+        APR_RING_FOREACH(tc, &(ts->tc_head), lcut_tc_t, link) {
+            if (tc->wall_ns + tc->fixture_ns <= 0) {
+                continue;
             }
-            APR_RING_FOREACH(tc, &(ts->tc_head), lcut_tc_t, link) {
-                if (tc != NULL) {
-                    if (tc->before != NULL) {
-                        tc->before();
-                    }
+            cases[ncases].ts = ts;
+            cases[ncases].tc = tc;
+            cases[ncases].ns = tc->wall_ns + tc->fixture_ns;
+            suites[nsuites].ns += cases[ncases++].ns;
+            wall   += tc->wall_ns;
+            cpu    += tc->cpu_ns;
+            before += tc->fixture_ns;
+        }
 
-                    tc->func(tc, tc->para);
+        if (suites[nsuites].ns > 0) {
+            nsuites++;
+        }
+    }
 
-                    if (tc->after != NULL) {
-                        tc->after();
-                    }
+    lcut_writer_printf(w, "\nTimes: \n");
+    if (test->wall_ns > 0) {
+        lcut_writer_printf(w, "\tWall Time: %.3f ms \n", test->wall_ns / 1e6);
+    }
+    lcut_writer_printf(w, "\tCase Time: %.3f ms, cpu %.3f ms \n", wall / 1e6, cpu / 1e6);
+    lcut_writer_printf(w, "\tFixture Time: %.3f ms before/after, %.3f ms setup/teardown \n",
+                       before / 1e6, (setup + test->fixture_ns) / 1e6);
 
-                    if (tc->status == TEST_CASE_SUCCESS) {
-                        printf(SUCCESS_TIP_FMT, tc->desc);
-                    } else if (tc->status == TEST_CASE_FAILURE) {
-                        ts->failed ++;
-                        printf(FAILURE_TIP_FMT, tc->desc, tc->fcname, tc->line,
-                               tc->fname, tc->reason);
-                        (*result) = TEST_CASE_FAILURE;
-                    }
-                }
-            }
-            if (ts->teardown != NULL) {
-                ts->teardown();
-            }
+    if (test->top > 0 && ncases > 0) {
+        spent_top(cases, ncases, test->top);
+        lcut_writer_printf(w, "\tSlowest Cases: \n");
+        for (i = 0; i < test->top && i < ncases; i++) {
+            lcut_writer_printf(w, "\t\t%.3f ms\t%s/%s \n", cases[i].ns / 1e6, cases[i].ts->desc, cases[i].tc->desc);
         }
     }
 
-    if (test->teardown != NULL) {
-        test->teardown();
+    if (test->top > 0 && nsuites > 0) {
+        spent_top(suites, nsuites, test->top);
+        lcut_writer_printf(w, "\tSlowest Suites: \n");
+        for (i = 0; i < test->top && i < nsuites; i++) {
+            lcut_writer_printf(w, "\t\t%.3f ms\t%s \n", suites[i].ns / 1e6, suites[i].ts->desc);
+        }
     }
 
+    free(cases);
+    free(suites);
 }
 
 void lcut_test_report(lcut_test_t *test) {
     int failed_suites = 0;
     int failed_cases  = 0;
+    int slow_cases    = 0;
+    int flaky_cases   = 0;
+    long long asserts = 0;
     lcut_ts_t *ts  = NULL;
+    lcut_tc_t *tc  = NULL;
+    lcut_writer_t *w = _stdout_writer;
+
+    /* the stdout may be taken by another reporter */
+    if (test->list || !test->console) {
+        return;
+    }
 
     APR_RING_FOREACH(ts, &(test->ts_head), lcut_ts_t, link) {
         if (ts != NULL) {
@@ -325,30 +6883,90 @@ void lcut_test_report(lcut_test_t *test) {
                 failed_suites++;
             }
             failed_cases += ts->failed;
+            slow_cases += ts->slow;
+            flaky_cases += ts->flaky;
+            APR_RING_FOREACH(tc, &(ts->tc_head), lcut_tc_t, link) {
+                asserts += tc->asserts;
+            }
+        }
+    }
+    if (test->quiet) {
+        if (failed_suites > 0) {
+            lcut_writer_printf(w, "\n\tFailed Cases: %d of %d \n", failed_cases, test->cases - test->dropped_cases);
+            lcut_writer_printf(w, "%s", REDBAR);
         }
+        lcut_writer_flush(w);
+        return;
+    }
+
+    lcut_writer_printf(w, "\nSummary: \n");
+    if (test->shard_count > 1) {
+        lcut_writer_printf(w, "\tShard: %d/%d \n", test->shard_index, test->shard_count);
+    }
+    lcut_writer_printf(w, "\tTotal Suites: %d \n", test->suites - test->dropped_suites);
+    lcut_writer_printf(w, "\tFailed Suites: %d \n", failed_suites);
+    lcut_writer_printf(w, "\tTotal Cases: %d \n", test->cases - test->dropped_cases);
+    lcut_writer_printf(w, "\tFailed Cases: %d \n", failed_cases);
+    if (asserts > 0) {
+        lcut_writer_printf(w, "\tAssertions: %lld \n", asserts);
+    }
+    if (test->dropped_cases > 0) {
+        lcut_writer_printf(w, "\tDeselected Cases: %d \n", test->dropped_cases);
     }
-    printf("\nSummary: \n");
-    printf("\tTotal Suites: %d \n", test->suites);
-    printf("\tFailed Suites: %d \n", failed_suites);
-    printf("\tTotal Cases: %d \n", test->cases);
-    printf("\tFailed Cases: %d \n", failed_cases);
+    if (test->skipped_cases > 0) {
+        lcut_writer_printf(w, "\tSkipped Cases: %d (stopped after %d failed cases) \n",
+                           test->skipped_cases, failed_cases);
+    }
+    if (slow_cases > 0) {
+        lcut_writer_printf(w, "\tSlow Cases: %d \n", slow_cases);
+    }
+    if (flaky_cases > 0) {
+        lcut_writer_printf(w, "\tFlaky Cases: %d \n", flaky_cases);
+    }
+
+    report_times(test, w);
 
     if (failed_suites == 0) {
-        printf(GREENBAR);
+        lcut_writer_printf(w, "%s", GREENBAR);
     } else {
-        printf(REDBAR);
+        lcut_writer_printf(w, "%s", REDBAR);
     }
+    lcut_writer_flush(w);
 }
 
 void* lcut_mock_obj(const char *fcname,
                     int lineno,
                     const char *fname,
                     int obj_type) {
+    lcut_mock_site_t    site    = {0};
+
+    return lcut_mock_site_obj(&site, fcname, lineno, fname, obj_type);
+}
+
+/*
+ * the interned name of a call site, resolved by the first thread getting
+ * there; the threads racing it intern the same name to the same id
+ */
+static int site_symbol(lcut_mock_site_t *site, const char *symbol_name) {
+    int id = ATOMIC_LOAD(&(site->id));
+
+    if (id == 0) {
+        id = intern_symbol(symbol_name) + 1;
+        ATOMIC_STORE(&(site->id), id);
+    }
+
+    return id - 1;
+}
+
+void* lcut_mock_site_obj(lcut_mock_site_t *site,
+                         const char *fcname,
+                         int lineno,
+                         const char *fname,
+                         int obj_type) {
     lcut_symbol_t   *s  = NULL;
-    lcut_value_t    *v  = NULL;
     void            *p;
 
-    s = lookup_symbol(fcname, obj_type);
+    s = lookup_symbol(site_symbol(site, fcname), obj_type, 0);
     if (!s) {
         printf("\t[LCUT]: can't find the symbol: <%s> which is being mocked!, %d line in file %s\n", 
                 fcname, lineno, fname);
@@ -357,18 +6975,12 @@ void* lcut_mock_obj(const char *fcname,
 
     if (s->always_return_flag) return s->value;
 
-    v = get_value(s);
-    if (!v) {
+    if (get_value(s, &p) != 0) {
         printf("\t[LCUT]: you have not set the value of mock obj <%s>!, %d line in file %s\n", 
                 fcname, lineno, fname);
         exit(EXIT_FAILURE);
     }
 
-    p = v->value;
-
-    APR_RING_REMOVE(v, link);
-    free(v);
-
     return p;
 }
 
@@ -379,45 +6991,162 @@ void lcut_mock_obj_return(const char *symbol_name,
                           const char *fname,
                           int obj_type,
                           int count) {
-  
+    lcut_mock_site_t    site    = {0};
+
+    lcut_mock_site_return(&site, symbol_name, value, fcname, lineno, fname, obj_type, count);
+}
+
+void lcut_mock_site_return(lcut_mock_site_t *site,
+                           const char *symbol_name,
+                           void *value,
+                           const char *fcname, 
+                           int lineno,
+                           const char *fname,
+                           int obj_type,
+                           int count) {
     lcut_symbol_t   *s  = NULL;
+    int             on  = alloc_pause();
 
-    s = lookup_symbol(symbol_name, obj_type);
-    if (!s) {
-        errno = 0;
-        s = (lcut_symbol_t*)malloc(sizeof(*s));
-        if (!s) {
+    s = lookup_symbol(site_symbol(site, symbol_name), obj_type, 1);
+    add_value(s, value, count);
+    alloc_resume(on);
+}
+
+static void mock_init(void) {
+    memset(&_mocks, 0, sizeof(_mocks));
+}
+
+static void mock_clear(void) {
+    lcut_symbol_t   *s      = NULL;
+    int             i;
+
+    for (i = 0; i < _mocks.cap; i++) {
+        if ((s = _mocks.symbols[i]) == NULL) {
+            continue;
+        }
+        free(s->runs);
+        free(s);
+    }
+
+    free(_mocks.symbols);
+    memset(&_mocks, 0, sizeof(_mocks));
+}
+
+static lcut_intern_t* intern_slot(lcut_intern_t *slots, size_t cap,
+                                  unsigned long long h, const char *name) {
+    size_t  i = (size_t)h & (cap - 1);
+
+    while (slots[i].name != NULL && (slots[i].hash != h || strcmp(slots[i].name, name))) {
+        i = (i + 1) & (cap - 1);
+    }
+
+    return &(slots[i]);
+}
+
+/*
+ * the id of a symbol name, the same for all the threads
+ */
+static int intern_symbol(const char *symbol_name) {
+    unsigned long long  h       = hash_mix(hash_str(0xcbf29ce484222325ULL, symbol_name));
+    lcut_intern_t       *slots  = NULL;
+    lcut_intern_t       *slot   = NULL;
+    const char          **names = NULL;
+    size_t              cap, i;
+    int                 on      = alloc_pause();
+    int                 id;
+
+    pthread_mutex_lock(&(_interns.lock));
+
+    if ((size_t)(_interns.count + 1) * 2 > _interns.cap) {
+        cap = _interns.cap > 0 ? _interns.cap * 2 : 64;
+        if ((slots = calloc(cap, sizeof(lcut_intern_t))) == NULL) {
+            printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        if ((names = realloc(_interns.names, cap / 2 * sizeof(char*))) == NULL) {
+            printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        for (i = 0; i < _interns.cap; i++) {
+            if (_interns.slots[i].name != NULL) {
+                (*intern_slot(slots, cap, _interns.slots[i].hash, _interns.slots[i].name)) = _interns.slots[i];
+            }
+        }
+        free(_interns.slots);
+        _interns.slots = slots;
+        _interns.names = names;
+        _interns.cap   = cap;
+    }
+
+    slot = intern_slot(_interns.slots, _interns.cap, h, symbol_name);
+    if (slot->name == NULL) {
+        if ((slot->name = strdup(symbol_name)) == NULL) {
             printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
             exit(EXIT_FAILURE);
         }
-        memset(s, 0, sizeof(*s));
-        strncpy(s->desc, symbol_name, LCUT_MAX_NAME_LEN);
-        s->obj_type = obj_type;
-        APR_RING_INIT(&(s->value_list), lcut_value_t, link);
-        APR_RING_INSERT_TAIL(&_symbol_list, s, lcut_symbol_t, link);
+        slot->hash = h;
+        slot->id   = _interns.count++;
+        _interns.names[slot->id] = slot->name;
     }
+    id = slot->id;
 
-    return add_value(s, value, count);
+    pthread_mutex_unlock(&(_interns.lock));
+    alloc_resume(on);
+
+    return id;
 }
 
-static lcut_symbol_t* lookup_symbol(const char *symbol_name, int obj_type) {
-    lcut_symbol_t   *s  = NULL;
+/*
+ * the symbol of the calling thread, created when asked for
+ */
+static lcut_symbol_t* lookup_symbol(int id, int obj_type, int create) {
+    lcut_symbol_t   **symbols   = NULL;
+    lcut_symbol_t   *s          = NULL;
+    int             i           = id * 2 + obj_type;
+    int             cap;
 
-    APR_RING_FOREACH(s, &_symbol_list, lcut_symbol_t, link) {
-        if (s != NULL) {
-            if ((s->obj_type == obj_type)
-                && (!strcmp(s->desc, symbol_name))) {
-                return s;
-            }
+    if (i < _mocks.cap && _mocks.symbols[i] != NULL) {
+        return _mocks.symbols[i];
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    if (i >= _mocks.cap) {
+        cap = _mocks.cap > 0 ? _mocks.cap : 16;
+        while (cap <= i) {
+            cap *= 2;
+        }
+        if ((symbols = realloc(_mocks.symbols, cap * sizeof(lcut_symbol_t*))) == NULL) {
+            printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+            exit(EXIT_FAILURE);
         }
+        memset(symbols + _mocks.cap, 0, (cap - _mocks.cap) * sizeof(lcut_symbol_t*));
+        _mocks.symbols = symbols;
+        _mocks.cap     = cap;
     }
 
-    return NULL;
+    errno = 0;
+    s = (lcut_symbol_t*)malloc(sizeof(*s));
+    if (!s) {
+        printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_lock(&(_interns.lock));
+    s->desc     = _interns.names[id];
+    pthread_mutex_unlock(&(_interns.lock));
+    s->obj_type = obj_type;
+    _mocks.symbols[i] = s;
+
+    return s;
 }
 
 static void add_value(lcut_symbol_t *s, void *value, int count) {
-    lcut_value_t    *v  = NULL;
-    int i;
+    lcut_value_t    *runs   = NULL;
+    lcut_value_t    *last   = NULL;
+    int             cap, i;
 
     /* 
      * make the obj always to return one same value 
@@ -431,23 +7160,54 @@ static void add_value(lcut_symbol_t *s, void *value, int count) {
 
     s->always_return_flag = 0;
 
-    for (i = 0; i < count; i++) {
-        errno = 0;    
-        v = (lcut_value_t*)malloc(sizeof(*v));
-        if (!v) {
+    if (count <= 0) {
+        return;
+    }
+
+    /* the same value again only lengthens the last run */
+    if (s->nruns > 0) {
+        last = &(s->runs[(s->head + s->nruns - 1) & (s->cap - 1)]);
+        if (last->value == value && last->count <= 0x7fffffff - count) {
+            last->count += count;
+            return;
+        }
+    }
+
+    if (s->nruns == s->cap) {
+        cap = s->cap > 0 ? s->cap * 2 : 4;
+        errno = 0;
+        runs = (lcut_value_t*)malloc(cap * sizeof(lcut_value_t));
+        if (!runs) {
             printf("\t[LCUT]: malloc error!, errcode[%d]\n", errno);
             exit(EXIT_FAILURE);
         }
-        memset(v, 0, sizeof(*v));
-        v->value    = value;
-
-        APR_RING_INSERT_TAIL(&(s->value_list), v, lcut_value_t, link);
+        for (i = 0; i < s->nruns; i++) {
+            runs[i] = s->runs[(s->head + i) & (s->cap - 1)];
+        }
+        free(s->runs);
+        s->runs = runs;
+        s->cap  = cap;
+        s->head = 0;
     }
+
+    s->runs[(s->head + s->nruns) & (s->cap - 1)].value = value;
+    s->runs[(s->head + s->nruns) & (s->cap - 1)].count = count;
+    s->nruns++;
 }
 
-static lcut_value_t* get_value(lcut_symbol_t *s) {
+static int get_value(lcut_symbol_t *s, void **value) {
     lcut_value_t    *v  = NULL;
 
-    v = APR_RING_FIRST(&(s->value_list));
-    return v;
+    if (s->nruns == 0) {
+        return ENOENT;
+    }
+
+    v = &(s->runs[s->head]);
+    (*value) = v->value;
+    if (--(v->count) == 0) {
+        s->head = (s->head + 1) & (s->cap - 1);
+        s->nruns--;
+    }
+
+    return 0;
 }
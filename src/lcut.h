@@ -18,7 +18,7 @@
  * @file lcut.h
  *
  * @brief a Lightweight C Unit Testing framework,
- *        working under single process and single-threaded environment
+ *        running the cases serially, or in forked processes or threads
  *
  * Here is a diagram to illustrate the orgnization of LCUT
  *     A logical Test
@@ -43,11 +43,14 @@ extern "C" {
 
 #include <stdio.h>
 #include <stdlib.h> /* for exit */
+#include <string.h> /* for strcmp */
 
 #include "apr_ring.h"
 
 #define LCUT_MAX_NAME_LEN 128
 #define LCUT_MAX_STR_LEN 128
+#define LCUT_MAX_ROW (64 * 1024)    /* the size of a row made by a row generator */
+#define LCUT_PROP_PART 1000         /* the iterations of a part of a property case */
 
 #define LCUT_LOGO \
 "*********************************************************\n\
@@ -55,8 +58,15 @@ extern "C" {
 \t\t By Tony Bai\n\
 *********************************************************"
 
-#define SUCCESS_TIP_FMT "\t\tCase '%s': Passed\n"
-#define FAILURE_TIP_FMT "\t\t\033[31mCase '%s': Failure occur in %s, %d line in file %s, %s\033[0m\n"
+#define SUCCESS_TIP_FMT "\t\tCase '%s': Passed (%s)\n"
+#define FLAKY_TIP_FMT "\t\t\033[35mCase '%s': Flaky, passed and failed by turns in the last %u runs\033[0m\n"
+#define BENCH_TIP_FMT "\t\t\tmin %.2f, median %.2f, mean %.2f, p99 %.2f, stddev %.2f ns/op (%d samples x %lld ops)\n"
+#define BASELINE_TIP_FMT "\t\t\tmedian %+.1f%% against the baseline %.2f ns/op\n"
+#define AB_TIP_FMT "\t\t\tA median %.2f, B median %.2f ns/op, speedup %.3fx, 95%% CI [%.3f, %.3f], Mann-Whitney p=%.4f (%d samples x %lld ops)\n"
+#define PERF_TIP_FMT "\t\t\t%s\n"
+#define SLOW_TIP_FMT "\t\t\033[33mCase '%s': Passed, but slow: %lld ms > %d ms (%s)\033[0m\n"
+#define FAILURE_TIP_FMT "\t\t\033[31mCase '%s': Failure occur in %s, %d line in file %s, %s (%s)\033[0m\n"
+#define FAILURE_REASON_FMT "\t\t\033[31mCase '%s': Failure occur, %s (%s)\033[0m\n"
 
 #define REDBAR \
 "\n=======================\n\
@@ -74,44 +84,264 @@ enum {
     TEST_CASE_FAILURE = 1
 };
 
+/* how lcut_test_run executes the cases when more than one job is asked for */
+enum {
+    LCUT_RUNNER_FORK = 0,       /* one worker process per job */
+    LCUT_RUNNER_THREAD = 1      /* one worker thread per job, in-process */
+};
+
+/* how the cases are split into shards */
+enum {
+    LCUT_SHARD_HASH = 0,        /* by the hash of suite/case description */
+    LCUT_SHARD_DURATION = 1     /* balanced by the durations in the timings file */
+};
+
 typedef struct lcut_tc_t lcut_tc_t;
 typedef void (*tc_func)(lcut_tc_t *tc, void *data);
+
+/*
+ * the heap allocations made by the thread of a case while its func runs
+ */
+typedef struct lcut_allocs_t {
+    long long                   count;                      /* malloc, calloc and realloc calls */
+    long long                   bytes;                      /* the bytes asked for by them */
+    long long                   peak;                       /* the most bytes allocated at once */
+    long long                   leaks;                      /* the blocks not freed when the func returns */
+    long long                   leaked;                     /* the bytes of those blocks */
+} lcut_allocs_t;
+
+/*
+ * the perf events counted on the thread of a case while its func runs,
+ * in user space, -1 when not counted. the software events are counted
+ * when the cpu has no hardware counters for the process
+ */
+typedef struct lcut_perf_t {
+    long long                   instructions;
+    long long                   cycles;
+    long long                   branch_misses;
+    long long                   l1d_misses;                 /* L1 data cache read misses */
+    long long                   llc_misses;                 /* last level cache misses */
+    long long                   task_clock_ns;              /* software: the cpu time of the thread */
+    long long                   page_faults;                /* software */
+    long long                   context_switches;           /* software */
+} lcut_perf_t;
+
+/*
+ * the state and the statistics of a benchmark case, in ns per op
+ */
+typedef struct lcut_bench_t {
+    long long                   n;                          /* the iterations of the running sample */
+    long long                   start;                      /* when the loop of the running sample began */
+    long long                   iters;                      /* the iterations of each sample */
+    long long                   ops;                        /* the iterations run in all, calibration included */
+    int                         wanted;                     /* the count of samples to take */
+    int                         samples;                    /* the count of samples taken */
+    double                      min_ns;
+    double                      median_ns;
+    double                      mean_ns;
+    double                      p99_ns;
+    double                      stddev_ns;
+    tc_func                     func_b;                     /* A/B benchmark: the B body, A is the case func */
+    int                         margin;                     /* A/B benchmark: B must be faster by margin %, <0: no */
+    double                      median_b_ns;                /* A/B benchmark: the statistics of B */
+    double                      speedup;                    /* A/B benchmark: median of A / median of B */
+    double                      speedup_lo;                 /* A/B benchmark: the 95% bootstrap interval */
+    double                      speedup_hi;
+    double                      p_value;                    /* A/B benchmark: Mann-Whitney, two-sided */
+} lcut_bench_t;
 typedef void (*fixture_func)(void);
 
+/*
+ * makes the row index of a parameterized case into row, a buffer of the
+ * row size of the case, in the process and thread which runs the row
+ */
+typedef void (*lcut_row_func)(void *data, int index, void *row);
+
+/*
+ * the rows of a parameterized case, a table or made on demand by gen
+ */
+typedef struct lcut_rows_t {
+    const void                  *table;                     /* the first row, NULL: the rows are made by gen */
+    size_t                      stride;                     /* the size of a row in bytes */
+    int                         count;                      /* the count of rows */
+    lcut_row_func               gen;
+    void                        *data;                      /* passed to gen */
+    lcut_tc_t                   *tc;                        /* the case the rows belong to */
+} lcut_rows_t;
+
+/*
+ * the iterations of a property case, more than LCUT_PROP_PART of them
+ * are split into parts which are the rows of the case
+ */
+typedef struct lcut_prop_t {
+    int                         iterations;                 /* the count of inputs tried */
+    int                         part;                       /* the iterations of a part */
+} lcut_prop_t;
+
+/*
+ * where and why a case failed, allocated only when it fails
+ */
+typedef struct lcut_failure_t {
+    const char                  *fname;                     /* the file name which the case failed in */
+    const char                  *fcname;                    /* the func name which the case failed in */
+    int                         line;                       /* the line number which the case failed at */
+    char                        reason[LCUT_MAX_STR_LEN];   /* the failed reason */
+    char                        *detail;                    /* the lines printed under the reason, or NULL */
+    char                        names[2 * LCUT_MAX_NAME_LEN];   /* fname and fcname unless they are literals */
+} lcut_failure_t;
+
+/*
+ * the storage of the cases of a suite, carved out of chunks
+ * which are freed all at once with the suite
+ */
+typedef struct lcut_chunk_t lcut_chunk_t;
+
+typedef struct lcut_arena_t {
+    lcut_chunk_t                *chunks;                    /* the latest first */
+    char                        *next;                      /* the free space of the latest chunk */
+    size_t                      left;
+    size_t                      grow;                       /* the size of the next chunk */
+} lcut_arena_t;
+
 struct lcut_tc_t {
     APR_RING_ENTRY(lcut_tc_t)   link;
-    char                        desc[LCUT_MAX_NAME_LEN];    /* the description literal of the test case */
+    const char                  *desc;                      /* the description of the test case */
     tc_func                     func;                       /* the executive body of the test case */
     void                        *para;                      /* the parameter passed into the func above */
     fixture_func                before;                     /* invoked before the test case func executed */
     fixture_func                after;                      /* invoked after the test case func executed */
     int                         status;                     /* the result of th test case executing*/
-    char                        fname[LCUT_MAX_NAME_LEN];   /* indicates the file name which the case lies in */
-    char                        fcname[LCUT_MAX_NAME_LEN];  /* indicates the func name when the case failed */
-    int                         line;                       /* indicates the line number when the case failed */
-    char                        reason[LCUT_MAX_STR_LEN];   /* string literal indicates the failed reason */
+    int                         timeout_ms;                 /* 0: the default timeout of the logical test */
+    lcut_failure_t              *failure;                   /* NULL unless the case failed */
+    long long                   wall_ns;                    /* the wall time of the func, CLOCK_MONOTONIC */
+    long long                   cpu_ns;                     /* the cpu time of the func, of its thread */
+    long long                   fixture_ns;                 /* the wall time of the before and after fixtures */
+    lcut_bench_t                *bench;                     /* not NULL for a benchmark case */
+    lcut_perf_t                 *perf;                      /* the perf events of the func, with --perf only */
+    long long                   asserts;                    /* the count of assertions checked by the func */
+    lcut_allocs_t               allocs;                     /* the heap allocations of the func */
+    lcut_rows_t                 *rows;                      /* not NULL for a parameterized case and its rows */
+    int                         row;                        /* the index of a row of a parameterized case */
+    lcut_prop_t                 *prop;                      /* not NULL for a property case and its parts */
 };
 typedef APR_RING_HEAD(lcut_tc_head_t, lcut_tc_t) lcut_tc_head_t;
 
+typedef struct lcut_test_t lcut_test_t;
+
 typedef struct lcut_ts_t {
     APR_RING_ENTRY(lcut_ts_t)   link;
-    char                        desc[LCUT_MAX_NAME_LEN];    /* the description literal of the test suite */
+    const char                  *desc;                      /* the description of the test suite */
     lcut_tc_head_t              tc_head;                    /* the head node of the test case ring */
+    lcut_arena_t                arena;                      /* the cases, their descriptions and benchmarks */
+    lcut_test_t                 *test;                      /* the logical test which it was added to */
     fixture_func                setup;                      /* setup function */
     fixture_func                teardown;                   /* teardown fucntion */
     int                         ran;                        /* the total count of test cases */
     int                         failed;                     /* the count of failed test case */
+    int                         slow;                       /* the count of passed but slow test case */
+    int                         flaky;                      /* the count of flaky test case */
+    long long                   setup_ns;                   /* the wall time of the setup, all the runs */
+    long long                   teardown_ns;                /* the wall time of the teardown, all the runs */
 } lcut_ts_t;
 typedef APR_RING_HEAD(lcut_ts_head_t, lcut_ts_t) lcut_ts_head_t;
 
-typedef struct lcut_test_t {
+/*
+ * the output of the reporters goes through a large buffer, written out
+ * when it fills, after each case when it is a terminal or a pipe, and
+ * when the run ends. on the stdout it is also written out before a line
+ * when the cases left something printed with stdio, so they keep their
+ * order, and without a terminal it has no colour codes.
+ */
+typedef struct lcut_writer_t lcut_writer_t;
+
+int lcut_writer_printf(lcut_writer_t *w, const char *fmt, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void lcut_writer_flush(lcut_writer_t *w);
+
+/*
+ * a finished case handed to lcut_reporter_t::case_end
+ */
+typedef struct lcut_case_report_t {
+    lcut_ts_t                   *ts;
+    lcut_tc_t                   *tc;
+    int                         index;                      /* the count of cases reported before */
+    int                         slow;                       /* 1: passed, but longer than the slow threshold */
+    int                         flaky;                      /* 1: passed and failed by turns in the history */
+    unsigned int                runs;                       /* the runs in the history window, this one too */
+    long long                   elapsed_ns;                 /* the wall time with the before and after */
+    double                      baseline_ns;                /* the median in the baseline, 0: none */
+} lcut_case_report_t;
+
+/*
+ * the listener of a run, any callback may be NULL. the events come from
+ * the thread calling lcut_test_run, in the order of the suites and the
+ * cases. with workers a case starts and ends at once, when its result
+ * comes back.
+ *
+ * lcut_test_add_reporter keeps r till lcut_test_destroy and opens out
+ * on path, "-" for the stdout, or leaves it NULL when path is NULL. the
+ * reporters of --junit, --tap and --json, and the console unless one of
+ * them took the stdout, are added by lcut_test_run after the others.
+ */
+typedef struct lcut_reporter_t lcut_reporter_t;
+struct lcut_reporter_t {
+    void (*run_start)(lcut_reporter_t *r, lcut_test_t *test);
+    void (*suite_start)(lcut_reporter_t *r, lcut_ts_t *ts);
+    void (*case_start)(lcut_reporter_t *r, lcut_ts_t *ts, lcut_tc_t *tc);
+    void (*case_end)(lcut_reporter_t *r, const lcut_case_report_t *report);
+    void (*suite_end)(lcut_reporter_t *r, lcut_ts_t *ts);
+    void (*run_end)(lcut_reporter_t *r, lcut_test_t *test);
+    void (*destroy)(lcut_reporter_t *r);                    /* called by lcut_test_destroy */
+    void                        *data;                      /* the reporter's own */
+    lcut_writer_t               *out;                       /* where the path given to lcut_test_add_reporter goes */
+    lcut_reporter_t             *next;
+};
+
+struct lcut_test_t {
     char                        desc[LCUT_MAX_NAME_LEN];    /* the description of a logical unit test */
     lcut_ts_head_t              ts_head;                    /* the head node of the test suite ring */
     fixture_func                setup;                      /* most top-level setup for the logic unit test */
     fixture_func                teardown;                   /* most top-level teardown for the logic unit test */
     int                         suites;                     /* the total count of test suites */
     int                         cases;                      /* the total count of test cases */
-} lcut_test_t;
+    int                         jobs;                       /* the count of workers, 1 means serial in-process */
+    int                         runner;                     /* LCUT_RUNNER_FORK or LCUT_RUNNER_THREAD */
+    const char                  *timings;                   /* the file remembering the case durations */
+    int                         timeout_ms;                 /* the default timeout of the cases, 0: none */
+    int                         slow_ms;                    /* the cases running longer are slow, 0: none */
+    int                         shard_index;                /* the shard to run, counting from 0 */
+    int                         shard_count;                /* the count of shards, 0 or 1: no sharding */
+    int                         shard_mode;                 /* LCUT_SHARD_HASH or LCUT_SHARD_DURATION */
+    const char                  *filter;                    /* ':' separated globs over "suite/case" */
+    int                         list;                       /* 1: list the cases instead of running them */
+    const char                  *results;                   /* the file to write the results into */
+    const char                  **merge;                    /* the results files to merge instead of running */
+    int                         nmerge;
+    int                         dropped_suites;             /* the count of suites not run */
+    int                         dropped_cases;              /* the count of cases not run */
+    const char                  *history;                   /* the file remembering the outcomes of the runs */
+    int                         max_failures;               /* stop after so many failed cases, 0: never */
+    int                         skipped_cases;              /* the count of cases skipped after the stop */
+    int                         top;                        /* the count of slowest cases and suites reported */
+    long long                   wall_ns;                    /* the wall time of lcut_test_run */
+    long long                   fixture_ns;                 /* the wall time of the setup and teardown */
+    int                         bench_samples;              /* the count of samples of each benchmark */
+    const char                  *bench_out;                 /* the file to export the benchmarks into */
+    const char                  *baseline;                  /* the benchmarks to compare with */
+    int                         save_baseline;              /* 1: write the benchmarks into baseline */
+    int                         max_regression;             /* the slowdown failing a benchmark, in % */
+    int                         perf;                       /* 1: count the perf events of the case funcs */
+    lcut_reporter_t             *reporters;                 /* the listeners of the run, in the order added */
+    int                         quiet;                      /* 1: the console prints the failures only */
+    int                         console;                    /* 1: the console reporter has the stdout */
+    const char                  *junit;                     /* the file to write the JUnit XML into */
+    const char                  *tap;                       /* the file to write the TAP stream into */
+    const char                  *json;                      /* the file to write the JSON lines into */
+    unsigned long long          seed;                       /* the seed of the property cases, 0: a new one */
+};
 
 int lcut_test_init(lcut_test_t **test, const char *title, fixture_func setup, fixture_func teardown);
 void lcut_test_destroy(lcut_test_t **test);
@@ -119,6 +349,16 @@ int lcut_ts_init(lcut_ts_t **ts, const char *title, fixture_func setup, fixture_
 void lcut_ts_add(lcut_test_t *test, lcut_ts_t *ts);
 int lcut_tc_add(lcut_ts_t *ts, const char *title, tc_func func,
                 void *para, fixture_func before, fixture_func after);
+int lcut_tc_add_timeout(lcut_ts_t *ts, const char *title, tc_func func,
+                        void *para, fixture_func before, fixture_func after, int timeout_ms);
+int lcut_tc_add_rows(lcut_ts_t *ts, const char *title, tc_func func, const void *table, size_t stride,
+                     int count, fixture_func before, fixture_func after);
+int lcut_tc_add_gen(lcut_ts_t *ts, const char *title, tc_func func, lcut_row_func gen, void *data,
+                    size_t size, int count, fixture_func before, fixture_func after);
+int lcut_prop_add(lcut_ts_t *ts, const char *title, tc_func func, void *para, int iterations,
+                  fixture_func before, fixture_func after);
+int lcut_test_args(lcut_test_t *test, int argc, char **argv);
+int lcut_test_add_reporter(lcut_test_t *test, lcut_reporter_t *r, const char *path);
 void lcut_test_run(lcut_test_t *test, int *result);
 void lcut_test_report(lcut_test_t *test);
 
@@ -138,6 +378,85 @@ void lcut_test_report(lcut_test_t *test);
         lcut_test_destroy(&_cut_test); \
     } while(0)
 
+/*
+ * Apply the command line options to the logical test,
+ * must be used after LCUT_TEST_BEGIN.
+ *
+ * -j N, --jobs=N   -- run the cases in N workers, 0 means one worker
+ *                     per online cpu (or LCUT_JOBS=N)
+ * --runner=fork      -- workers are forked processes, the default
+ * --runner=thread    -- workers are threads of the test process, each has
+ *                       its own mock objects (or LCUT_RUNNER=thread).
+ *                       a suite's setup runs once before its first case and
+ *                       its teardown once after its last case.
+ * --timings=FILE     -- remember the case durations in FILE, the workers
+ *                       then pick the longest cases first and steal from
+ *                       each other when they run out (or LCUT_TIMINGS=FILE)
+ * --timeout=MS       -- fail the cases running longer than MS milliseconds,
+ *                       unless they have their own timeout (or LCUT_TIMEOUT=MS).
+ *                       benchmarks are not timed out. with -j 1 a hung case
+ *                       is left by a longjmp out of a signal handler, which
+ *                       may leave a lock of malloc or stdio held and hang the
+ *                       rest of the run; -j 2 or more kills a forked worker
+ * --slow=MS          -- report the cases running longer than MS milliseconds
+ *                       as slow (or LCUT_SLOW=MS)
+ * --shard=I/N        -- run the shard I (from 0) of N shards only
+ *                       (or LCUT_SHARD_INDEX=I and LCUT_SHARD_COUNT=N)
+ * --shard-mode=MODE  -- "hash" of suite/case, the default, or "duration"
+ *                       balanced by the timings file (or LCUT_SHARD_MODE)
+ * --filter=GLOBS     -- run the cases whose "suite/case" matches one of
+ *                       the ':' separated globs, and none of the globs
+ *                       starting with '-' (or LCUT_FILTER=GLOBS)
+ * --history=FILE     -- remember the outcomes of the cases in FILE, the
+ *                       cases failed in the last run then run first and
+ *                       the flaky ones are reported (or LCUT_HISTORY=FILE)
+ * --fail-fast        -- stop at the first failed case
+ * --max-failures=N   -- stop after N failed cases (or LCUT_MAX_FAILURES=N),
+ *                       the cases left are skipped, the teardowns owed run
+ * --top=N            -- report the N slowest cases and suites, 5 by
+ *                       default, 0 for none (or LCUT_TOP=N)
+ * --bench-samples=N  -- take N samples of about 1 ms for each benchmark
+ *                       case, 100 by default (or LCUT_BENCH_SAMPLES=N)
+ * --bench-out=FILE   -- export the benchmark results into FILE, as csv
+ *                       if it ends in ".csv", as json otherwise
+ *                       (or LCUT_BENCH_OUT=FILE)
+ * --baseline=FILE    -- compare the benchmarks with those in FILE, a
+ *                       benchmark fails when its median is slower by more
+ *                       than --max-regression=PCT percent, 10 by default,
+ *                       beyond the noise (or LCUT_BASELINE=FILE and
+ *                       LCUT_MAX_REGRESSION=PCT)
+ * --save-baseline    -- write the benchmarks of the run into the baseline
+ * --perf             -- count the instructions, cycles, branch misses, L1d
+ *                       and LLC misses of each case func, per op for the
+ *                       benchmarks, or the task clock, page faults and
+ *                       context switches when the cpu has no counters for
+ *                       the process (or LCUT_PERF=1)
+ * --list             -- print the "suite/case" of the selected cases
+ *                       without running any fixture or case
+ * --results=FILE     -- write the results of the cases into FILE
+ *                       (or LCUT_RESULTS=FILE)
+ * --merge=FILE       -- may be repeated, report the results of the FILEs
+ *                       written by the shards instead of running the cases
+ * --quiet            -- print the failed cases only (or LCUT_QUIET=1)
+ * --junit=FILE       -- write the results as JUnit XML into FILE
+ *                       (or LCUT_JUNIT=FILE)
+ * --tap=FILE         -- write the results as a TAP stream into FILE
+ *                       (or LCUT_TAP=FILE)
+ * --json=FILE        -- write the events of the run as JSON lines into FILE
+ *                       (or LCUT_JSON=FILE)
+ * --seed=N           -- the seed of the inputs of the property cases, a new
+ *                       one each run by default, the failed ones report
+ *                       theirs (or LCUT_SEED=N)
+ *
+ * a FILE of "-" is the stdout, which then has no console output
+ */
+#define LCUT_TEST_ARGS(argc, argv) do { \
+        if ((_cut_status = lcut_test_args(_cut_test, (argc), (argv))) != 0) { \
+            printf("[LCUT]: test args parse failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
 /*
  * initialize a Test Suite
  *
@@ -180,6 +499,260 @@ void lcut_test_report(lcut_test_t *test);
         } \
     } while(0)
 
+/*
+ * Add a test case which fails when it runs longer than ms milliseconds
+ *
+ * p -- lcut_ts_t*
+ * s -- test case description
+ * f -- test case function
+ * e -- extra parameter
+ * ms -- the timeout of the case, 0 means the default one
+ */
+#define LCUT_TC_ADD_TIMEOUT(p, s, f, e, before, after, ms) do { \
+        if ((_cut_status = lcut_tc_add_timeout((p), (s), (f), (e), (before), (after), (ms))) != 0) { \
+            printf("[LCUT]: test case add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * Add a parameterized test case, f runs once for each row of a table
+ * with the row as its extra parameter
+ *
+ * the rows are cases of their own when the test runs, "s/0", "s/1"...,
+ * they run in parallel like any case, --filter picks a row by its index,
+ * e.g. "suite/s/3", or all of them by the name of the case. nothing is
+ * allocated per row until the run, then one case per selected row.
+ *
+ * p -- lcut_ts_t*
+ * s -- test case description
+ * f -- test case function
+ * t -- the table, an array of at least n rows
+ * n -- the count of rows
+ */
+#define LCUT_TC_ADD_ROWS(p, s, f, t, n, before, after) do { \
+        if ((_cut_status = lcut_tc_add_rows((p), (s), (f), (t), sizeof((t)[0]), (n), \
+                                            (before), (after))) != 0) { \
+            printf("[LCUT]: test case add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * Add a parameterized test case whose rows are made by gen when they
+ * run, into a buffer of size bytes, at most LCUT_MAX_ROW, on the stack
+ * of the case
+ *
+ * p    -- lcut_ts_t*
+ * s    -- test case description
+ * f    -- test case function
+ * gen  -- lcut_row_func, called as gen(data, index, row)
+ * data -- passed to gen
+ * size -- the size of a row
+ * n    -- the count of rows
+ */
+#define LCUT_TC_ADD_GEN(p, s, f, gen, data, size, n, before, after) do { \
+        if ((_cut_status = lcut_tc_add_gen((p), (s), (f), (gen), (data), (size), (n), \
+                                           (before), (after))) != 0) { \
+            printf("[LCUT]: test case add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * Add a property case, f runs once for each of n inputs drawn by the
+ * lcut_gen_* functions from a PRNG seeded by --seed and the iteration
+ *
+ * the first input failing f is shrunk to a simpler one which still fails,
+ * by replaying f on fewer and smaller draws, then the case fails with
+ * the reason of the shrunk input, prefixed by the seed and the iteration,
+ * and the input generated is printed under it. more than LCUT_PROP_PART
+ * iterations are split into parts, "s/0", "s/1"..., which run in
+ * parallel like the rows of a parameterized case.
+ *
+ * p -- lcut_ts_t*
+ * s -- test case description
+ * f -- test case function
+ * e -- extra parameter
+ * n -- the count of inputs, 0 means LCUT_PROP_PART
+ */
+#define LCUT_PROP_ADD(p, s, f, e, n, before, after) do { \
+        if ((_cut_status = lcut_prop_add((p), (s), (f), (e), (n), (before), (after))) != 0) { \
+            printf("[LCUT]: test case add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * the generators of a property case, each draw shrinks toward 0, lo, the
+ * empty buffer or the first char of the alphabet. outside a property case
+ * they return those
+ *
+ * lcut_gen_bytes fills buf with up to max bytes, lcut_gen_string with up
+ * to size - 1 chars of alphabet, NULL for the printable ones, and a '\0',
+ * both return the length
+ */
+int lcut_gen_int(lcut_tc_t *tc);
+long long lcut_gen_range(lcut_tc_t *tc, long long lo, long long hi);
+size_t lcut_gen_bytes(lcut_tc_t *tc, void *buf, size_t max);
+size_t lcut_gen_string(lcut_tc_t *tc, char *buf, size_t size, const char *alphabet);
+
+/*
+ * the cases and suites defined by LCUT_CASE and LCUT_SUITE, laid out by
+ * the linker in the sections lcut_cases and lcut_suites, the records are
+ * sorted by file and line when they are added to a test
+ */
+typedef struct lcut_case_t {
+    const char                  *suite;                     /* the title of the suite */
+    const char                  *name;                      /* the title of the case */
+    tc_func                     func;
+    lcut_tc_t                   *tc;                        /* the static storage of the case */
+    const char                  *file;
+    long                        line;
+} lcut_case_t;
+
+typedef struct lcut_suite_t {
+    const char                  *name;                      /* the title of the suite */
+    fixture_func                setup;
+    fixture_func                teardown;
+    const char                  *file;
+} lcut_suite_t;
+
+int lcut_test_add_cases(lcut_test_t *test, lcut_case_t *cases, lcut_case_t *cases_end,
+                        const lcut_suite_t *suites, const lcut_suite_t *suites_end);
+const char* lcut_basename(const char *path);
+
+#if defined(__GNUC__) && defined(__ELF__)
+/* defined by the linker in the program, NULL when there is no record */
+extern lcut_case_t __start_lcut_cases[] __attribute__((weak));
+extern lcut_case_t __stop_lcut_cases[] __attribute__((weak));
+extern const lcut_suite_t __start_lcut_suites[] __attribute__((weak));
+extern const lcut_suite_t __stop_lcut_suites[] __attribute__((weak));
+
+/*
+ * Define a test case of a suite, both identifiers, which is registered
+ * when the program links and allocates nothing when it is added
+ *
+ * LCUT_CASE(calculator, add) {
+ *     LCUT_INT_EQUAL(tc, 10, add(2, 8));
+ * }
+ */
+#define LCUT_CASE(suite, name) \
+    static void _cut_func_##suite##_##name(lcut_tc_t *tc, void *data); \
+    static lcut_tc_t _cut_tc_##suite##_##name; \
+    static lcut_case_t _cut_case_##suite##_##name \
+        __attribute__((used, section("lcut_cases"), aligned(sizeof(void*)))) = { \
+        #suite, #name, _cut_func_##suite##_##name, &_cut_tc_##suite##_##name, __FILE__, __LINE__ \
+    }; \
+    static void _cut_func_##suite##_##name(lcut_tc_t *tc, void *data)
+
+/*
+ * Give the suite of LCUT_CASE its fixtures, once in the whole program.
+ * a suite without LCUT_SUITE has none.
+ */
+#define LCUT_SUITE(suite, setup, teardown) \
+    static const lcut_suite_t _cut_suite_##suite \
+        __attribute__((used, section("lcut_suites"), aligned(sizeof(void*)))) = { \
+        #suite, (setup), (teardown), __FILE__ \
+    }
+
+/*
+ * Add the cases of LCUT_CASE to the test, must be used after
+ * LCUT_TEST_BEGIN, the suites go after those added before
+ */
+#define LCUT_CASES_ADD() do { \
+        if ((_cut_status = lcut_test_add_cases(_cut_test, __start_lcut_cases, __stop_lcut_cases, \
+                                               __start_lcut_suites, __stop_lcut_suites)) != 0) { \
+            printf("[LCUT]: test cases add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * the whole main() of a program of LCUT_CASEs, named after the program
+ */
+#define LCUT_MAIN() \
+    int main(int argc, char **argv) { \
+        LCUT_TEST_BEGIN(lcut_basename(argv[0]), NULL, NULL); \
+        LCUT_TEST_ARGS(argc, argv); \
+        LCUT_CASES_ADD(); \
+        LCUT_TEST_RUN(); \
+        LCUT_TEST_REPORT(); \
+        LCUT_TEST_END(); \
+        LCUT_TEST_RESULT(); \
+    }
+#endif
+
+/*
+ * Add a benchmark case to a test suite, f runs its body in LCUT_BENCH_LOOP
+ *
+ * the iterations of the loop are calibrated until a sample lasts about
+ * 1 ms, then the samples are taken after a warmup one. the fixtures run
+ * once around all of them. the statistics are reported in ns per op,
+ * they are best taken with -j 1, away from the other cases.
+ *
+ * p -- lcut_ts_t*
+ * s -- benchmark case description
+ * f -- benchmark case function
+ * e -- extra parameter
+ */
+#define LCUT_BENCH_ADD(p, s, f, e, before, after) do { \
+        if ((_cut_status = lcut_bench_add((p), (s), (f), (e), (before), (after))) != 0) { \
+            printf("[LCUT]: bench case add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * Add an A/B benchmark case to a test suite, the samples of fa and fb are
+ * taken by turns with the same fixtures and the same extra parameter
+ *
+ * the speedup of B over A is reported with its 95% bootstrap interval
+ * and the p-value of a Mann-Whitney test of the two sets of samples.
+ *
+ * p -- lcut_ts_t*
+ * s -- benchmark case description
+ * fa -- the A body, the old implementation
+ * fb -- the B body, the new implementation
+ * e -- extra parameter
+ * margin -- the case fails unless B is faster than A by margin percent,
+ *           the whole interval above it and p < 0.05; negative: never fails
+ */
+#define LCUT_BENCH_AB_ADD(p, s, fa, fb, e, before, after, margin) do { \
+        if ((_cut_status = lcut_bench_ab_add((p), (s), (fa), (fb), (e), (before), (after), (margin))) != 0) { \
+            printf("[LCUT]: bench case add failed!, errcode[%d]\n", _cut_status); \
+            exit(1); \
+        } \
+    } while(0)
+
+/*
+ * the loop of a benchmark case, what comes before it is not timed
+ *
+ * void bench_add(lcut_tc_t *tc, void *data) {
+ *     LCUT_BENCH_LOOP(tc) {
+ *         LCUT_BENCH_SINK(add(2, 8));
+ *     }
+ * }
+ */
+#define LCUT_BENCH_LOOP(tc) \
+    for (long long _cut_iter = lcut_bench_n(tc); _cut_iter > 0; _cut_iter--)
+
+/*
+ * keep the compiler from optimizing away the computation of a value
+ */
+#if defined(__GNUC__)
+#define LCUT_BENCH_SINK(v) do { \
+        __typeof__(v) _cut_sink = (v); \
+        __asm__ __volatile__("" : : "r"(&_cut_sink) : "memory"); \
+    } while(0)
+#else
+#define LCUT_BENCH_SINK(v) do { \
+        lcut_bench_sink = (double)(v); \
+    } while(0)
+#endif
+
+extern volatile double lcut_bench_sink;
+
 /*
  * Run a logical unit test
  */
@@ -203,99 +776,337 @@ void lcut_test_report(lcut_test_t *test);
         exit(_cut_result); \
     } while(0)
 
-void lcut_int_equal(lcut_tc_t *tc, const int expected, const int actual, int lineno,
-                    const char *fcname, const char *fname);
-void lcut_int_nequal(lcut_tc_t *tc, const int expected, const int actual, int lineno,
-                     const char *fcname, const char *fname);
-void lcut_str_equal(lcut_tc_t *tc, const char *expected, const char *actual, int lineno,
-                    const char *fcname, const char *fname);
-void lcut_str_nequal(lcut_tc_t *tc, const char *expected, const char *actual, int lineno, 
-                    const char *fcname, const char *fname);
-void lcut_assert(lcut_tc_t *tc, const char *msg, int condition,
-                 int lineno, const char *fcname, const char *fname);
-void lcut_true(lcut_tc_t *tc, int condition,
-               int lineno, const char *fcname, const char *fname);
+int lcut_bench_add(lcut_ts_t *ts, const char *title, tc_func func, void *para,
+                   fixture_func before, fixture_func after);
+int lcut_bench_ab_add(lcut_ts_t *ts, const char *title, tc_func fa, tc_func fb, void *para,
+                      fixture_func before, fixture_func after, int margin);
+long long lcut_bench_n(lcut_tc_t *tc);
+
+/*
+ * the assertions below compare inline and count themselves into
+ * lcut_tc_t::asserts, the lcut_* functions are called only to record
+ * a failure, out of the way of the code which passes
+ */
+#ifdef __GNUC__
+#define LCUT_UNLIKELY(x)    __builtin_expect(!!(x), 0)
+#define LCUT_COLD           __attribute__((cold))
+#else
+#define LCUT_UNLIKELY(x)    (x)
+#define LCUT_COLD
+#endif
+
+LCUT_COLD void lcut_int_equal(lcut_tc_t *tc, const int expected, const int actual, int lineno,
+                              const char *fcname, const char *fname);
+LCUT_COLD void lcut_int_nequal(lcut_tc_t *tc, const int expected, const int actual, int lineno,
+                               const char *fcname, const char *fname);
+LCUT_COLD void lcut_str_equal(lcut_tc_t *tc, const char *expected, const char *actual, int lineno,
+                              const char *fcname, const char *fname);
+LCUT_COLD void lcut_str_nequal(lcut_tc_t *tc, const char *expected, const char *actual, int lineno, 
+                               const char *fcname, const char *fname);
+LCUT_COLD void lcut_assert(lcut_tc_t *tc, const char *msg, int condition,
+                           int lineno, const char *fcname, const char *fname);
+LCUT_COLD void lcut_true(lcut_tc_t *tc, int condition,
+                         int lineno, const char *fcname, const char *fname);
+void lcut_mem_equal(lcut_tc_t *tc, const void *expected, const void *actual, size_t len,
+                    int lineno, const char *fcname, const char *fname);
+void lcut_array_equal(lcut_tc_t *tc, const void *expected, const void *actual, size_t count,
+                      size_t size, int lineno, const char *fcname, const char *fname);
+LCUT_COLD void lcut_double_near(lcut_tc_t *tc, double expected, double actual, double tolerance,
+                                int lineno, const char *fcname, const char *fname);
+void lcut_double_ulp_equal(lcut_tc_t *tc, double expected, double actual, long long ulps,
+                           int lineno, const char *fcname, const char *fname);
+void lcut_float_ulp_equal(lcut_tc_t *tc, float expected, float actual, long long ulps,
+                          int lineno, const char *fcname, const char *fname);
+void lcut_float_array_near(lcut_tc_t *tc, const float *expected, const float *actual, size_t count,
+                           double abs_tol, double rel_tol,
+                           int lineno, const char *fcname, const char *fname);
+void lcut_double_array_near(lcut_tc_t *tc, const double *expected, const double *actual, size_t count,
+                            double abs_tol, double rel_tol,
+                            int lineno, const char *fcname, const char *fname);
+void lcut_float_array_ulp(lcut_tc_t *tc, const float *expected, const float *actual, size_t count,
+                          long long ulps, int lineno, const char *fcname, const char *fname);
+void lcut_double_array_ulp(lcut_tc_t *tc, const double *expected, const double *actual, size_t count,
+                           long long ulps, int lineno, const char *fcname, const char *fname);
+void lcut_allocs_le(lcut_tc_t *tc, long long n,
+                    int lineno, const char *fcname, const char *fname);
+void lcut_no_leaks(lcut_tc_t *tc,
+                   int lineno, const char *fcname, const char *fname);
+void lcut_instructions_le(lcut_tc_t *tc, long long n,
+                          int lineno, const char *fcname, const char *fname);
+void lcut_cycles_le(lcut_tc_t *tc, long long n,
+                    int lineno, const char *fcname, const char *fname);
+
+/* the hooks of liblcut_alloc tell the blocks of the case func by these */
+void lcut_alloc_hooks(void);
+void lcut_alloc_track(void *p, size_t size);
+void lcut_alloc_untrack(void *p);
 
 #define LCUT_INT_EQUAL(tc, expected, actual) do { \
-        lcut_int_equal(tc, expected, actual, __LINE__, __FUNCTION__, __FILE__); \
+        int _cut_e = (expected); \
+        int _cut_a = (actual); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(_cut_e != _cut_a)) { \
+            lcut_int_equal(tc, _cut_e, _cut_a, __LINE__, __FUNCTION__, __FILE__); \
+        } \
     } while(0)
 
 #define LCUT_INT_NEQUAL(tc, expected, actual) do { \
-        lcut_int_nequal(tc, expected, actual, __LINE__, __FUNCTION__, __FILE__); \
+        int _cut_e = (expected); \
+        int _cut_a = (actual); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(_cut_e == _cut_a)) { \
+            lcut_int_nequal(tc, _cut_e, _cut_a, __LINE__, __FUNCTION__, __FILE__); \
+        } \
     } while(0)
 
 #define LCUT_STR_EQUAL(tc, expected, actual) do { \
-        lcut_str_equal(tc, expected, actual, __LINE__, __FUNCTION__, __FILE__); \
+        const char *_cut_e = (expected); \
+        const char *_cut_a = (actual); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(_cut_e != _cut_a && (!_cut_e || !_cut_a || strcmp(_cut_e, _cut_a)))) { \
+            lcut_str_equal(tc, _cut_e, _cut_a, __LINE__, __FUNCTION__, __FILE__); \
+        } \
     } while(0)
 
 #define LCUT_STR_NEQUAL(tc, expected, actual) do { \
-        lcut_str_nequal(tc, expected, actual, __LINE__, __FUNCTION__, __FILE__); \
+        const char *_cut_e = (expected); \
+        const char *_cut_a = (actual); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(_cut_e && _cut_a ? !strcmp(_cut_e, _cut_a) : _cut_e == _cut_a)) { \
+            lcut_str_nequal(tc, _cut_e, _cut_a, __LINE__, __FUNCTION__, __FILE__); \
+        } \
     } while(0)
 
 #define LCUT_ASSERT(tc, msg, condition) do { \
-        lcut_assert(tc, msg, (condition), __LINE__, __FUNCTION__, __FILE__); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(!(condition))) { \
+            lcut_assert(tc, msg, 0, __LINE__, __FUNCTION__, __FILE__); \
+        } \
     } while(0)
 
 #define LCUT_TRUE(tc, condition) do { \
-        lcut_true(tc, condition, __LINE__, __FUNCTION__, __FILE__); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(!(condition))) { \
+            lcut_true(tc, 0, __LINE__, __FUNCTION__, __FILE__); \
+        } \
     } while(0)
 
 /*
- * mock symbol list
+ * compare whole buffers, with SSE2 or AVX2 as the cpu has. a failure
+ * reports the first mismatch, how many differ, and the bytes or the
+ * elements around the first one
+ *
+ * LCUT_MEM_EQUAL   -- len bytes at expected and actual are equal
+ * LCUT_ARRAY_EQUAL -- count elements at expected and actual are equal,
+ *                     the element size comes from the type of expected,
+ *                     int8_t up to int64_t are printed as integers
+ */
+#define LCUT_MEM_EQUAL(tc, expected, actual, len) do { \
+        (tc)->asserts++; \
+        lcut_mem_equal(tc, (expected), (actual), (len), __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_ARRAY_EQUAL(tc, expected, actual, count) do { \
+        (tc)->asserts++; \
+        lcut_array_equal(tc, (expected), (actual), (count), sizeof(*(expected)), \
+                         __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+/*
+ * compare floating point values within a tolerance. NaN is never near
+ * anything, equal infinities are. a ulp is a unit in the last place,
+ * the distance counts the representable values between expected and
+ * actual, -0.0 and 0.0 are 0 ulps apart
+ *
+ * LCUT_DOUBLE_NEAR       -- |actual - expected| <= tolerance
+ * LCUT_DOUBLE_ULP_EQUAL  -- expected and actual are at most ulps apart
+ * LCUT_FLOAT_ULP_EQUAL   -- the same in single precision
+ *
+ * the array forms run vectorized with SSE2 or AVX2 as the cpu has. an
+ * element passes when |actual - expected| <= abs_tol + rel_tol * |expected|,
+ * or is at most ulps apart, a failure reports how many elements are out
+ * of tolerance, the worst of them with its index and error, and the
+ * elements around it
+ *
+ * LCUT_FLOAT_ARRAY_NEAR  -- count floats within abs_tol and rel_tol
+ * LCUT_DOUBLE_ARRAY_NEAR -- count doubles within abs_tol and rel_tol
+ * LCUT_FLOAT_ARRAY_ULP   -- count floats at most ulps apart
+ * LCUT_DOUBLE_ARRAY_ULP  -- count doubles at most ulps apart
+ */
+#define LCUT_DOUBLE_NEAR(tc, expected, actual, tolerance) do { \
+        double _cut_e = (expected); \
+        double _cut_a = (actual); \
+        double _cut_t = (tolerance); \
+        (tc)->asserts++; \
+        if (LCUT_UNLIKELY(_cut_e != _cut_a && \
+                          !(_cut_a - _cut_e <= _cut_t && _cut_e - _cut_a <= _cut_t))) { \
+            lcut_double_near(tc, _cut_e, _cut_a, _cut_t, __LINE__, __FUNCTION__, __FILE__); \
+        } \
+    } while(0)
+
+#define LCUT_DOUBLE_ULP_EQUAL(tc, expected, actual, ulps) do { \
+        (tc)->asserts++; \
+        lcut_double_ulp_equal(tc, (expected), (actual), (ulps), __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_FLOAT_ULP_EQUAL(tc, expected, actual, ulps) do { \
+        (tc)->asserts++; \
+        lcut_float_ulp_equal(tc, (expected), (actual), (ulps), __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_FLOAT_ARRAY_NEAR(tc, expected, actual, count, abs_tol, rel_tol) do { \
+        (tc)->asserts++; \
+        lcut_float_array_near(tc, (expected), (actual), (count), (abs_tol), (rel_tol), \
+                              __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_DOUBLE_ARRAY_NEAR(tc, expected, actual, count, abs_tol, rel_tol) do { \
+        (tc)->asserts++; \
+        lcut_double_array_near(tc, (expected), (actual), (count), (abs_tol), (rel_tol), \
+                               __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_FLOAT_ARRAY_ULP(tc, expected, actual, count, ulps) do { \
+        (tc)->asserts++; \
+        lcut_float_array_ulp(tc, (expected), (actual), (count), (ulps), \
+                             __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_DOUBLE_ARRAY_ULP(tc, expected, actual, count, ulps) do { \
+        (tc)->asserts++; \
+        lcut_double_array_ulp(tc, (expected), (actual), (count), (ulps), \
+                              __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+/*
+ * the heap allocations are tracked with glibc only, when the program is
+ * linked with liblcut_alloc (-llcut_alloc -llcut), whose malloc, calloc,
+ * realloc, free, memalign, posix_memalign, aligned_alloc, valloc and
+ * pvalloc forward to glibc. without it nothing is counted and the checks
+ * below fail with "allocation tracking not linked"
+ *
+ * LCUT_ALLOCS_LE -- the case func has called malloc, calloc and realloc
+ *                   no more than n times so far, on its own thread
+ * LCUT_NO_LEAKS  -- all the blocks allocated by the case func so far
+ *                   have been freed
+ */
+#define LCUT_ALLOCS_LE(tc, n) do { \
+        (tc)->asserts++; \
+        lcut_allocs_le(tc, (n), __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_NO_LEAKS(tc) do { \
+        (tc)->asserts++; \
+        lcut_no_leaks(tc, __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+/*
+ * LCUT_INSTRUCTIONS_LE -- the case func has retired at most n instructions
+ *                         so far, in user space
+ * LCUT_CYCLES_LE       -- the case func has taken at most n cycles so far
+ *
+ * they pass when the events are not counted, without --perf or on a cpu
+ * with no hardware counters for the process.
+ */
+#define LCUT_INSTRUCTIONS_LE(tc, n) do { \
+        (tc)->asserts++; \
+        lcut_instructions_le(tc, (n), __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+#define LCUT_CYCLES_LE(tc, n) do { \
+        (tc)->asserts++; \
+        lcut_cycles_le(tc, (n), __LINE__, __FUNCTION__, __FILE__); \
+    } while(0)
+
+/*
+ * mock symbol table
+ *
+ * the symbol names are interned once for the process, the id of a name
+ * indexes the symbols of every thread, and each LCUT_MOCK_* call site
+ * caches the id of its name. the values to return are queued as runs
+ * of the same value in a ring buffer.
  *
  * ------------
- * | symbol-#0|-> value_list
- * ------------
- * | symbol-#1|-> value_list
+ * | symbol-#0|-> [value x count][value x count]...     (id 0, MOCK_ARG)
  * ------------
- * | symbol-#2|-> value_list
+ * | symbol-#1|-> [value x count]...                    (id 0, MOCK_RETV)
  * ------------
- * | ... ...  |-> value_list
+ * | ... ...  |-> ...
  * ------------
- * | symbol-#n|-> value_list
+ * | symbol-#n|-> ...                                   (id n / 2, n % 2)
  * ------------
  */
 
 typedef struct lcut_value_t {
-    APR_RING_ENTRY(lcut_value_t)    link;
     void                            *value;
+    int                             count;              /* the times left to return the value */
 } lcut_value_t;
-typedef APR_RING_HEAD(lcut_value_head_t, lcut_value_t) lcut_value_head_t;
 
 typedef struct lcut_symbol_t {
-    APR_RING_ENTRY(lcut_symbol_t)   link;
-    char                            desc[LCUT_MAX_NAME_LEN];
+    const char                      *desc;              /* the interned name */
     int                             obj_type;
     int                             always_return_flag; /* 1: always return the same value; 0(default) */
     void*                           value;
-    lcut_value_head_t               value_list;
+    lcut_value_t                    *runs;              /* the ring buffer of the queued values */
+    int                             cap;                /* power of 2 */
+    int                             head;               /* the run returned next */
+    int                             nruns;              /* the count of queued runs */
 } lcut_symbol_t;
-typedef APR_RING_HEAD(lcut_symbol_head_t, lcut_symbol_t) lcut_symbol_head_t;
+
+/*
+ * a mock call site, resolves its symbol name once
+ */
+typedef struct lcut_mock_site_t {
+    int                             id;                 /* the interned name + 1, 0: not resolved yet, atomic */
+} lcut_mock_site_t;
 
 void* lcut_mock_obj(const char *fcname, int lineno, const char *fname, int obj_type); 
 void lcut_mock_obj_return(const char *symbol_name, void *value, const char *fcname, 
                           int lineno, const char *fname, int obj_type, int count);
+void* lcut_mock_site_obj(lcut_mock_site_t *site, const char *fcname,
+                         int lineno, const char *fname, int obj_type);
+void lcut_mock_site_return(lcut_mock_site_t *site, const char *symbol_name, void *value,
+                           const char *fcname, int lineno, const char *fname, int obj_type, int count);
 
 #define MOCK_ARG                0x0
 #define MOCK_RETV               0x1
 
+/*
+ * the call sites of the mocked functions keep their own lcut_mock_site_t,
+ * which needs the statement expressions of GNU C
+ */
+#ifdef __GNUC__
+#define LCUT_MOCK_ARG() __extension__ ({ \
+        static lcut_mock_site_t _cut_site; \
+        lcut_mock_site_obj(&_cut_site, __FUNCTION__, __LINE__, __FILE__, MOCK_ARG); \
+    })
+#define LCUT_MOCK_RETV() __extension__ ({ \
+        static lcut_mock_site_t _cut_site; \
+        lcut_mock_site_obj(&_cut_site, __FUNCTION__, __LINE__, __FILE__, MOCK_RETV); \
+    })
+#else
 #define LCUT_MOCK_ARG() lcut_mock_obj(__FUNCTION__, __LINE__, __FILE__, MOCK_ARG)
 #define LCUT_MOCK_RETV() lcut_mock_obj(__FUNCTION__, __LINE__, __FILE__, MOCK_RETV)
+#endif
 
 #define LCUT_ARG_RETURN(fcname, value) do { \
-        lcut_mock_obj_return(#fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_ARG, 1); \
+        static lcut_mock_site_t _cut_site; \
+        lcut_mock_site_return(&_cut_site, #fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_ARG, 1); \
     } while(0);
 
 #define LCUT_ARG_RETURN_COUNT(fcname, value, count) do { \
-        lcut_mock_obj_return(#fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_ARG, count); \
+        static lcut_mock_site_t _cut_site; \
+        lcut_mock_site_return(&_cut_site, #fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_ARG, count); \
     } while(0);
 
 #define LCUT_RETV_RETURN(fcname, value) do { \
-        lcut_mock_obj_return(#fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_RETV, 1); \
+        static lcut_mock_site_t _cut_site; \
+        lcut_mock_site_return(&_cut_site, #fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_RETV, 1); \
     } while(0);
 
 #define LCUT_RETV_RETURN_COUNT(fcname, value, count) do { \
-        lcut_mock_obj_return(#fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_RETV, count); \
+        static lcut_mock_site_t _cut_site; \
+        lcut_mock_site_return(&_cut_site, #fcname, (void*)value, __FUNCTION__, __LINE__, __FILE__, MOCK_RETV, count); \
     } while(0);
 
 #ifdef _cplusplus
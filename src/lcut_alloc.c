@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2005-2010 Tony Bai <bigwhite.cn@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * liblcut_alloc -- the optional hooks of the allocation checks, linked
+ * into a test program by -llcut_alloc before -llcut.
+ *
+ * malloc and friends are interposed and forward to glibc, the blocks go
+ * to the tracker of liblcut, which counts them while a case func runs on
+ * the thread. libc's own callers of malloc, strdup and the like, are
+ * hooked too.
+ */
+
+#define _GNU_SOURCE /* valloc and pvalloc are hidden by -std=c99 */
+#include <errno.h>
+#include "lcut.h"
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+extern void __libc_free(void *p);
+
+/* the allocation checks fail unless liblcut knows it is hooked */
+__attribute__((constructor))
+static void hooks_linked(void) {
+    lcut_alloc_hooks();
+}
+
+void* malloc(size_t size) {
+    void    *p = __libc_malloc(size);
+
+    lcut_alloc_track(p, size);
+    return p;
+}
+
+void* calloc(size_t n, size_t size) {
+    void    *p = __libc_calloc(n, size);
+
+    lcut_alloc_track(p, n * size);
+    return p;
+}
+
+void* realloc(void *p, size_t size) {
+    void    *q = __libc_realloc(p, size);
+
+    if (q == NULL && size > 0) {
+        return q;
+    }
+
+    lcut_alloc_untrack(p);
+    lcut_alloc_track(q, size);
+    return q;
+}
+
+void free(void *p) {
+    lcut_alloc_untrack(p);
+    __libc_free(p);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    void    *p = __libc_memalign(alignment, size);
+
+    lcut_alloc_track(p, size);
+    return p;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    void    *p = NULL;
+
+    if (alignment == 0 || alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    if ((p = memalign(alignment, size)) == NULL) {
+        return ENOMEM;
+    }
+
+    (*memptr) = p;
+    return 0;
+}
+
+void* valloc(size_t size) {
+    void    *p = __libc_valloc(size);
+
+    lcut_alloc_track(p, size);
+    return p;
+}
+
+void* pvalloc(size_t size) {
+    void    *p = __libc_pvalloc(size);
+
+    lcut_alloc_track(p, size);
+    return p;
+}
+#endif
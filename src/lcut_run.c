@@ -0,0 +1,901 @@
+/*
+ * Copyright (c) 2005-2010 Tony Bai <bigwhite.cn@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * lcut-run -- runs the lcut test binaries concurrently and merges their
+ * results into one report and one exit status.
+ *
+ * usage: lcut-run [options] [PATH...] [-- ARGS...]
+ *
+ * a PATH naming a directory is searched, with its sub directories except
+ * the hidden ones (.libs, .deps), for the executables whose name matches
+ * the pattern. a PATH naming a file is run as it is. the current directory
+ * is searched when no PATH is given.
+ *
+ * -j N, --jobs=N     -- run N binaries at once, 0, the default, means one
+ *                       per online cpu (or LCUT_RUN_JOBS=N)
+ * --pattern=GLOB     -- the names of the binaries to search for, "*test*"
+ *                       by default
+ * --timeout=SEC      -- kill the binaries running longer than SEC seconds,
+ *                       with the workers they forked
+ * --quiet            -- print the failed binaries only
+ * -- ARGS            -- pass ARGS to every binary, e.g. -- --filter='calc*'
+ *                       (a binary takes them by LCUT_TEST_ARGS or LCUT_MAIN)
+ *
+ * every binary runs with LCUT_QUIET=1 and LCUT_JSON=/dev/fd/3, so its
+ * results come back as JSON lines over a pipe on its fd 3, and its console
+ * output over another pipe, which is shown when the binary dies. a line
+ * is written as each case ends, so a binary killed or hung still tells
+ * the cases it ran.
+ *
+ * the files named by LCUT_RESULTS, LCUT_TIMINGS, LCUT_HISTORY,
+ * LCUT_BENCH_OUT and LCUT_BASELINE get the name of the binary as a suffix,
+ * e.g. LCUT_HISTORY=h becomes h.calculator_test for calculator_test, so the
+ * binaries running at once keep their own files. the same options given
+ * after -- are passed as they are and shared by every binary.
+ *
+ * a binary still runs LCUT_JOBS cases at once, so up to N * LCUT_JOBS
+ * cases run together; set LCUT_JOBS=1 to keep N.
+ */
+
+#define _GNU_SOURCE /* fork, pipe and poll are hidden by -std=c99 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "lcut.h"
+
+#define LCUT_RUN_FD         3           /* the fd the binaries write their JSON lines into */
+#define LCUT_RUN_LOG        (1 << 14)   /* the tail of the console output kept for a binary */
+#define LCUT_RUN_READ       (1 << 16)
+
+typedef struct lcut_run_failure_t {
+    char                        *name;          /* "suite/case" */
+    char                        *function;
+    char                        *file;
+    int                         line;
+    char                        *reason;
+    char                        *detail;
+    char                        times[128];
+    struct lcut_run_failure_t   *next;
+} lcut_run_failure_t;
+
+typedef struct lcut_run_bin_t {
+    char                *path;
+    char                *title;         /* the title of the logical test */
+    pid_t               pid;
+    int                 fds[2];         /* the console output and the JSON lines, -1 once closed */
+    char                *line;          /* the JSON line being read */
+    size_t              line_len;
+    size_t              line_cap;
+    char                log[LCUT_RUN_LOG];
+    size_t              log_len;
+    int                 started;
+    int                 finished;
+    int                 ended;          /* 1: the run_end event came */
+    int                 timed_out;
+    int                 status;         /* as waitpid tells */
+    int                 error;          /* the errno of a failed start */
+    int                 cases;
+    int                 failed;
+    int                 skipped;
+    long long           start_ns;
+    long long           ns;
+    lcut_run_failure_t  *failures;
+    lcut_run_failure_t  **tail;         /* set at the start, the bins are sorted then */
+} lcut_run_bin_t;
+
+typedef struct lcut_run_t {
+    lcut_run_bin_t      *bins;
+    int                 nbins;
+    int                 cap;
+    int                 jobs;
+    const char          *pattern;
+    int                 timeout_sec;
+    int                 quiet;
+    char                **args;         /* the argv of the binaries, args[0] is set per binary */
+} lcut_run_t;
+
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static const char* option_value(const char *name, int argc, char **argv, int *i) {
+    size_t  len = strlen(name);
+
+    if (strncmp(argv[*i], name, len)) {
+        return NULL;
+    }
+
+    if (argv[*i][len] == '=') {
+        return argv[*i] + len + 1;
+    }
+
+    if (argv[*i][len] == '\0' && (*i) + 1 < argc) {
+        return argv[++(*i)];
+    }
+
+    return NULL;
+}
+
+static int parse_count(const char *str, int *n) {
+    char    *end    = NULL;
+    long    v;
+
+    errno = 0;
+    v = strtol(str, &end, 10);
+    if (errno != 0 || end == str || *end != '\0' || v < 0 || v > 1000000) {
+        return EINVAL;
+    }
+    (*n) = (int)v;
+    return 0;
+}
+
+static int bin_add(lcut_run_t *run, const char *path) {
+    lcut_run_bin_t  *bins   = NULL;
+    lcut_run_bin_t  *b      = NULL;
+
+    if (run->nbins == run->cap) {
+        run->cap = run->cap > 0 ? run->cap * 2 : 16;
+        if ((bins = realloc(run->bins, run->cap * sizeof(*bins))) == NULL) {
+            return ENOMEM;
+        }
+        run->bins = bins;
+    }
+
+    b = &(run->bins[run->nbins]);
+    memset(b, 0, sizeof(*b));
+    if ((b->path = strdup(path)) == NULL) {
+        return ENOMEM;
+    }
+    b->fds[0] = -1;
+    b->fds[1] = -1;
+    run->nbins++;
+    return 0;
+}
+
+/*
+ * the hidden directories are skipped, libtool keeps the real binaries
+ * behind its wrapper scripts in .libs
+ */
+static int discover(lcut_run_t *run, const char *dir) {
+    DIR             *d      = NULL;
+    struct dirent   *e      = NULL;
+    struct stat     st;
+    char            *path   = NULL;
+    int             rv      = 0;
+
+    if ((d = opendir(dir)) == NULL) {
+        return errno;
+    }
+
+    while (rv == 0 && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') {
+            continue;
+        }
+        if (asprintf(&path, "%s/%s", dir, e->d_name) < 0) {
+            rv = ENOMEM;
+            break;
+        }
+        if (stat(path, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                rv = discover(run, path);
+            } else if (S_ISREG(st.st_mode) && (st.st_mode & S_IXUSR)
+                       && fnmatch(run->pattern, e->d_name, 0) == 0) {
+                rv = bin_add(run, path);
+            }
+        }
+        free(path);
+    }
+
+    closedir(d);
+    return rv;
+}
+
+static int bin_cmp(const void *a, const void *b) {
+    return strcmp(((const lcut_run_bin_t *)a)->path, ((const lcut_run_bin_t *)b)->path);
+}
+
+static int cloexec_pipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        return errno;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+/*
+ * the per binary name of the file named by the env var, if it is set;
+ * called in the child, after the fork
+ */
+static void bin_env_file(const char *name, const char *path) {
+    const char  *v      = getenv(name);
+    const char  *base   = strrchr(path, '/');
+    char        buf[4096];
+
+    if (v == NULL || *v == '\0') {
+        return;
+    }
+    base = (base != NULL) ? base + 1 : path;
+    if (snprintf(buf, sizeof(buf), "%s.%s", v, base) < (int)sizeof(buf)) {
+        setenv(name, buf, 1);
+    } else {
+        unsetenv(name);
+    }
+}
+
+/*
+ * the pipes are close-on-exec, so a binary does not hold those of the
+ * others open; dup2 clears the flag on the fds it passes down
+ */
+static int bin_start(lcut_run_t *run, lcut_run_bin_t *b) {
+    int     out[2]  = {-1, -1};
+    int     res[2]  = {-1, -1};
+    int     null_fd;
+
+    if ((b->error = cloexec_pipe(out)) != 0) {
+        return b->error;
+    }
+    if ((b->error = cloexec_pipe(res)) != 0) {
+        close(out[0]);
+        close(out[1]);
+        return b->error;
+    }
+
+    b->tail     = &(b->failures);
+    b->start_ns = now_ns();
+    if ((b->pid = fork()) < 0) {
+        b->error = errno;
+        close(out[0]);
+        close(out[1]);
+        close(res[0]);
+        close(res[1]);
+        return b->error;
+    }
+
+    if (b->pid == 0) {
+        /* a group of its own, so a timeout kills its workers too */
+        setpgid(0, 0);
+        if ((null_fd = open("/dev/null", O_RDONLY)) >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+        }
+        dup2(out[1], STDOUT_FILENO);
+        dup2(out[1], STDERR_FILENO);
+        dup2(res[1], LCUT_RUN_FD);
+        setenv("LCUT_QUIET", "1", 1);
+        setenv("LCUT_JSON", "/dev/fd/3", 1);
+        /* nothing else may write to the shared stdout */
+        unsetenv("LCUT_TAP");
+        unsetenv("LCUT_JUNIT");
+        /* nor may the binaries share the files they write */
+        bin_env_file("LCUT_RESULTS", b->path);
+        bin_env_file("LCUT_TIMINGS", b->path);
+        bin_env_file("LCUT_HISTORY", b->path);
+        bin_env_file("LCUT_BENCH_OUT", b->path);
+        bin_env_file("LCUT_BASELINE", b->path);
+        run->args[0] = b->path;
+        execv(b->path, run->args);
+        printf("\t[LCUT]: exec %s failed!, errcode[%d]\n", b->path, errno);
+        fflush(stdout);
+        _exit(127);
+    }
+
+    setpgid(b->pid, b->pid);
+    close(out[1]);
+    close(res[1]);
+    b->fds[0]  = out[0];
+    b->fds[1]  = res[0];
+    b->started = 1;
+    return 0;
+}
+
+static void log_append(lcut_run_bin_t *b, const char *buf, size_t n) {
+    if (n >= LCUT_RUN_LOG) {
+        buf += n - LCUT_RUN_LOG;
+        n = LCUT_RUN_LOG;
+        b->log_len = 0;
+    } else if (b->log_len + n > LCUT_RUN_LOG) {
+        memmove(b->log, b->log + b->log_len + n - LCUT_RUN_LOG, LCUT_RUN_LOG - n);
+        b->log_len = LCUT_RUN_LOG - n;
+    }
+    memcpy(b->log + b->log_len, buf, n);
+    b->log_len += n;
+}
+
+/*
+ * decodes the JSON string at *p in place, lcut escapes '"', '\\' and the
+ * control characters only
+ */
+static char* json_string(char **p) {
+    char            *s  = ++(*p);
+    char            *d  = s;
+    unsigned int    u;
+
+    while (**p != '"') {
+        if (**p == '\0') {
+            return NULL;
+        }
+        if (**p != '\\') {
+            *d++ = *(*p)++;
+            continue;
+        }
+        (*p)++;
+        switch (**p) {
+        case 'n': *d++ = '\n'; break;
+        case 't': *d++ = '\t'; break;
+        case 'r': *d++ = '\r'; break;
+        case 'b': *d++ = '\b'; break;
+        case 'f': *d++ = '\f'; break;
+        case 'u':
+            if (sscanf((*p) + 1, "%4x", &u) != 1 || strlen((*p) + 1) < 4) {
+                return NULL;
+            }
+            *d++ = u < 0x80 ? (char)u : '?';
+            (*p) += 4;
+            break;
+        case '\0':
+            return NULL;
+        default:
+            *d++ = **p;
+            break;
+        }
+        (*p)++;
+    }
+    (*p)++;
+    *d = '\0';
+    return s;
+}
+
+/*
+ * picks the values of the keys out of a flat JSON object, the strings are
+ * decoded in place, the numbers and literals are left to strtol and strcmp
+ */
+static int json_fields(char *p, const char * const *keys, char **vals, int n) {
+    char    *key    = NULL;
+    char    *val    = NULL;
+    int     i;
+
+    for (i = 0; i < n; i++) {
+        vals[i] = NULL;
+    }
+
+    while (*p == ' ') {
+        p++;
+    }
+    if (*p++ != '{') {
+        return EINVAL;
+    }
+
+    for (;;) {
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+        if (*p == '}') {
+            return 0;
+        }
+        if (*p != '"' || (key = json_string(&p)) == NULL) {
+            return EINVAL;
+        }
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p++ != ':') {
+            return EINVAL;
+        }
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p == '"') {
+            if ((val = json_string(&p)) == NULL) {
+                return EINVAL;
+            }
+        } else {
+            val = p;
+            p += strcspn(p, ",} ");
+            if (p == val) {
+                return EINVAL;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (!strcmp(key, keys[i])) {
+                vals[i] = val;
+            }
+        }
+    }
+}
+
+static char* dup_or_empty(const char *str) {
+    return strdup(str != NULL ? str : "");
+}
+
+enum {
+    FIELD_EVENT, FIELD_TEST, FIELD_SUITE, FIELD_CASE, FIELD_STATUS, FIELD_WALL,
+    FIELD_CPU, FIELD_ASSERTIONS, FIELD_FILE, FIELD_LINE, FIELD_FUNCTION, FIELD_REASON,
+    FIELD_DETAIL, FIELD_CASES, FIELD_FAILED, FIELD_SKIPPED, FIELD_MAX
+};
+
+static const char * const _fields[FIELD_MAX] = {
+    "event", "test", "suite", "case", "status", "wall_ms", "cpu_ms", "assertions",
+    "file", "line", "function", "reason", "detail", "cases", "failed", "skipped"
+};
+
+static void bin_event(lcut_run_bin_t *b, char *line) {
+    char                *v[FIELD_MAX];
+    lcut_run_failure_t  *f      = NULL;
+    long long           asserts;
+
+    if (json_fields(line, _fields, v, FIELD_MAX) != 0 || v[FIELD_EVENT] == NULL) {
+        return;
+    }
+
+    if (!strcmp(v[FIELD_EVENT], "run_start")) {
+        free(b->title);
+        b->title = dup_or_empty(v[FIELD_TEST]);
+    } else if (!strcmp(v[FIELD_EVENT], "case")) {
+        /* counted as they come, the run_end may never come */
+        b->cases++;
+        if (v[FIELD_STATUS] == NULL || strcmp(v[FIELD_STATUS], "failed")) {
+            return;
+        }
+        b->failed++;
+        if ((f = calloc(1, sizeof(*f))) == NULL) {
+            return;
+        }
+        if (asprintf(&(f->name), "%s/%s", v[FIELD_SUITE] != NULL ? v[FIELD_SUITE] : "",
+                     v[FIELD_CASE] != NULL ? v[FIELD_CASE] : "") < 0) {
+            f->name = NULL;
+        }
+        f->function = dup_or_empty(v[FIELD_FUNCTION]);
+        f->file     = dup_or_empty(v[FIELD_FILE]);
+        f->reason   = dup_or_empty(v[FIELD_REASON]);
+        f->detail   = v[FIELD_DETAIL] != NULL ? strdup(v[FIELD_DETAIL]) : NULL;
+        f->line     = v[FIELD_LINE] != NULL ? atoi(v[FIELD_LINE]) : 0;
+        asserts     = v[FIELD_ASSERTIONS] != NULL ? atoll(v[FIELD_ASSERTIONS]) : 0;
+        snprintf(f->times, sizeof(f->times), "%.3f ms, cpu %.3f ms",
+                 v[FIELD_WALL] != NULL ? atof(v[FIELD_WALL]) : 0.0,
+                 v[FIELD_CPU] != NULL ? atof(v[FIELD_CPU]) : 0.0);
+        if (asserts > 0) {
+            snprintf(f->times + strlen(f->times), sizeof(f->times) - strlen(f->times),
+                     ", %lld assertion%s", asserts, asserts > 1 ? "s" : "");
+        }
+        *(b->tail) = f;
+        b->tail = &(f->next);
+    } else if (!strcmp(v[FIELD_EVENT], "run_end")) {
+        b->ended   = 1;
+        b->cases   = v[FIELD_CASES] != NULL ? atoi(v[FIELD_CASES]) : b->cases;
+        b->failed  = v[FIELD_FAILED] != NULL ? atoi(v[FIELD_FAILED]) : b->failed;
+        b->skipped = v[FIELD_SKIPPED] != NULL ? atoi(v[FIELD_SKIPPED]) : 0;
+    }
+}
+
+static int line_append(lcut_run_bin_t *b, const char *buf, size_t n) {
+    char    *line   = NULL;
+    size_t  cap     = b->line_cap > 0 ? b->line_cap : 256;
+
+    while (b->line_len + n + 1 > cap) {
+        cap *= 2;
+    }
+    if (cap != b->line_cap) {
+        if ((line = realloc(b->line, cap)) == NULL) {
+            return ENOMEM;
+        }
+        b->line     = line;
+        b->line_cap = cap;
+    }
+    memcpy(b->line + b->line_len, buf, n);
+    b->line_len += n;
+    b->line[b->line_len] = '\0';
+    return 0;
+}
+
+static void json_append(lcut_run_bin_t *b, const char *buf, size_t n) {
+    const char  *nl = NULL;
+
+    while (n > 0) {
+        if ((nl = memchr(buf, '\n', n)) == NULL) {
+            line_append(b, buf, n);
+            return;
+        }
+        if (line_append(b, buf, nl - buf) == 0) {
+            bin_event(b, b->line);
+        }
+        b->line_len = 0;
+        n  -= nl + 1 - buf;
+        buf = nl + 1;
+    }
+}
+
+static void bin_read(lcut_run_bin_t *b, int which) {
+    char        buf[LCUT_RUN_READ];
+    ssize_t     n;
+
+    n = read(b->fds[which], buf, sizeof(buf));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    if (n <= 0) {
+        close(b->fds[which]);
+        b->fds[which] = -1;
+        return;
+    }
+
+    if (which == 0) {
+        log_append(b, buf, n);
+    } else {
+        json_append(b, buf, n);
+    }
+}
+
+static void bin_reap(lcut_run_bin_t *b) {
+    while (waitpid(b->pid, &(b->status), 0) < 0 && errno == EINTR) {
+    }
+    b->ns       = now_ns() - b->start_ns;
+    b->finished = 1;
+    /* the last line may have no newline */
+    if (b->line_len > 0) {
+        bin_event(b, b->line);
+        b->line_len = 0;
+    }
+}
+
+/*
+ * keeps up to jobs binaries running and drains their pipes, a binary is
+ * reaped once both are closed
+ */
+static void run_bins(lcut_run_t *run) {
+    struct pollfd   *pfds   = NULL;
+    lcut_run_bin_t  **owner = NULL;
+    int             *which  = NULL;
+    int             next    = 0;
+    int             running = 0;
+    int             npfds;
+    int             wait_ms;
+    long long       left_ms;
+    long long       now;
+    int             i;
+
+    pfds  = calloc(run->jobs * 2, sizeof(*pfds));
+    owner = calloc(run->jobs * 2, sizeof(*owner));
+    which = calloc(run->jobs * 2, sizeof(*which));
+    if (pfds == NULL || owner == NULL || which == NULL) {
+        printf("\t[LCUT]: lcut-run out of memory!, errcode[%d]\n", ENOMEM);
+        exit(1);
+    }
+
+    while (next < run->nbins || running > 0) {
+        for (i = 0; i < next; i++) {
+            lcut_run_bin_t  *b  = &(run->bins[i]);
+
+            if (b->started && !b->finished && b->fds[0] < 0 && b->fds[1] < 0) {
+                bin_reap(b);
+                running--;
+            }
+        }
+        while (running < run->jobs && next < run->nbins) {
+            if (bin_start(run, &(run->bins[next])) == 0) {
+                running++;
+            }
+            next++;
+        }
+
+        npfds   = 0;
+        wait_ms = -1;
+        now     = now_ns();
+        for (i = 0; i < next; i++) {
+            lcut_run_bin_t  *b  = &(run->bins[i]);
+
+            if (!b->started || b->finished) {
+                continue;
+            }
+            if (run->timeout_sec > 0 && !b->timed_out) {
+                left_ms = (b->start_ns + run->timeout_sec * 1000000000LL - now) / 1000000LL;
+                if (left_ms <= 0) {
+                    /* the pipes are drained to their end, the binary is reaped with them */
+                    b->timed_out = 1;
+                    kill(-b->pid, SIGKILL);
+                } else if (wait_ms < 0 || left_ms < wait_ms) {
+                    wait_ms = (int)left_ms;
+                }
+            }
+            if (b->fds[0] >= 0) {
+                pfds[npfds].fd     = b->fds[0];
+                pfds[npfds].events = POLLIN;
+                owner[npfds]       = b;
+                which[npfds++]     = 0;
+            }
+            if (b->fds[1] >= 0) {
+                pfds[npfds].fd     = b->fds[1];
+                pfds[npfds].events = POLLIN;
+                owner[npfds]       = b;
+                which[npfds++]     = 1;
+            }
+        }
+        if (npfds == 0) {
+            continue;
+        }
+
+        if (poll(pfds, npfds, wait_ms) < 0) {
+            continue;
+        }
+        for (i = 0; i < npfds; i++) {
+            if (pfds[i].revents != 0) {
+                bin_read(owner[i], which[i]);
+            }
+        }
+    }
+
+    free(pfds);
+    free(owner);
+    free(which);
+}
+
+static int bin_passed(const lcut_run_bin_t *b) {
+    return b->ended && b->failed == 0 && WIFEXITED(b->status) && WEXITSTATUS(b->status) == 0;
+}
+
+/*
+ * a binary failed by its cases tells about them, a binary dead for any
+ * other reason shows the tail of its console output
+ */
+static void report_bin(const lcut_run_t *run, const lcut_run_bin_t *b) {
+    lcut_run_failure_t  *f      = NULL;
+    const char          *p      = NULL;
+    const char          *end    = NULL;
+    const char          *nl     = NULL;
+    int                 died    = 0;
+
+    if (run->quiet && bin_passed(b)) {
+        return;
+    }
+
+    printf("\tBinary <%s>", b->path);
+    if (b->title != NULL) {
+        printf(" '%s'", b->title);
+    }
+
+    if (!b->started) {
+        printf(": \033[31mNot started, errcode[%d]\033[0m\n", b->error);
+        return;
+    }
+
+    if (b->timed_out) {
+        printf(": \033[31mKilled after %d s, %d cases reported\033[0m", run->timeout_sec, b->cases);
+        died = 1;
+    } else if (WIFSIGNALED(b->status)) {
+        printf(": \033[31mKilled by signal %d, %d cases reported\033[0m", WTERMSIG(b->status), b->cases);
+        died = 1;
+    } else if (!b->ended) {
+        printf(": \033[31mExited with %d, no results reported\033[0m", WEXITSTATUS(b->status));
+        died = 1;
+    } else if (b->failed > 0) {
+        printf(": Failed %d of %d cases", b->failed, b->cases);
+    } else if (WEXITSTATUS(b->status) != 0) {
+        printf(": \033[31mExited with %d, %d cases passed\033[0m", WEXITSTATUS(b->status), b->cases);
+        died = 1;
+    } else {
+        printf(": Passed %d case%s", b->cases, b->cases != 1 ? "s" : "");
+    }
+    if (b->skipped > 0) {
+        printf(", %d skipped", b->skipped);
+    }
+    printf(" (%.3f ms)\n", b->ns / 1e6);
+
+    for (f = b->failures; f != NULL; f = f->next) {
+        if (f->file != NULL && f->file[0] != '\0') {
+            printf(FAILURE_TIP_FMT, f->name != NULL ? f->name : "", f->function, f->line,
+                   f->file, f->reason, f->times);
+        } else {
+            printf(FAILURE_REASON_FMT, f->name != NULL ? f->name : "", f->reason, f->times);
+        }
+        if (f->detail != NULL) {
+            printf("%s", f->detail);
+        }
+    }
+
+    if (!died || b->log_len == 0) {
+        return;
+    }
+    p   = b->log;
+    end = b->log + b->log_len;
+    while (p < end) {
+        nl = memchr(p, '\n', end - p);
+        printf("\t\t| %.*s\n", (int)((nl != NULL ? nl : end) - p), p);
+        p = nl != NULL ? nl + 1 : end;
+    }
+}
+
+static int report(const lcut_run_t *run, long long wall_ns) {
+    int         failed_bins     = 0;
+    int         cases           = 0;
+    int         failed_cases    = 0;
+    int         skipped_cases   = 0;
+    long long   bins_ns         = 0;
+    int         i;
+
+    if (!run->quiet) {
+        printf("%s \n", LCUT_LOGO);
+        printf("Unit Test Binaries: %d, run %d at once\n\n", run->nbins, run->jobs);
+    }
+
+    for (i = 0; i < run->nbins; i++) {
+        const lcut_run_bin_t    *b  = &(run->bins[i]);
+
+        report_bin(run, b);
+        if (!bin_passed(b)) {
+            failed_bins++;
+        }
+        cases         += b->cases;
+        failed_cases  += b->failed;
+        skipped_cases += b->skipped;
+        bins_ns       += b->ns;
+    }
+
+    if (run->quiet) {
+        if (failed_bins > 0) {
+            printf("\n\tFailed Binaries: %d of %d \n", failed_bins, run->nbins);
+            printf("\tFailed Cases: %d of %d \n", failed_cases, cases);
+            printf("%s", REDBAR);
+        }
+        return failed_bins > 0;
+    }
+
+    printf("\nSummary: \n");
+    printf("\tTotal Binaries: %d \n", run->nbins);
+    printf("\tFailed Binaries: %d \n", failed_bins);
+    printf("\tTotal Cases: %d \n", cases);
+    printf("\tFailed Cases: %d \n", failed_cases);
+    if (skipped_cases > 0) {
+        printf("\tSkipped Cases: %d \n", skipped_cases);
+    }
+    printf("\tWall Time: %.3f ms, the binaries one after another: %.3f ms \n",
+           wall_ns / 1e6, bins_ns / 1e6);
+    printf("%s", failed_bins == 0 ? GREENBAR : REDBAR);
+    return failed_bins > 0;
+}
+
+static void run_destroy(lcut_run_t *run) {
+    lcut_run_failure_t  *f      = NULL;
+    lcut_run_failure_t  *next   = NULL;
+    int                 i;
+
+    for (i = 0; i < run->nbins; i++) {
+        for (f = run->bins[i].failures; f != NULL; f = next) {
+            next = f->next;
+            free(f->name);
+            free(f->function);
+            free(f->file);
+            free(f->reason);
+            free(f->detail);
+            free(f);
+        }
+        free(run->bins[i].path);
+        free(run->bins[i].title);
+        free(run->bins[i].line);
+    }
+    free(run->bins);
+    free(run->args);
+}
+
+int main(int argc, char **argv) {
+    lcut_run_t  run;
+    const char  *v      = NULL;
+    char        **paths = NULL;
+    struct stat st;
+    int         npaths  = 0;
+    int         nargs   = 0;
+    int         rv      = 0;
+    int         i;
+    long long   begin;
+
+    memset(&run, 0, sizeof(run));
+    run.pattern = "*test*";
+    if ((v = getenv("LCUT_RUN_JOBS")) != NULL && *v != '\0' && parse_count(v, &(run.jobs)) != 0) {
+        printf("\t[LCUT]: invalid LCUT_RUN_JOBS %s, errcode[%d]\n", v, EINVAL);
+        return 1;
+    }
+    if ((run.args = calloc(argc + 1, sizeof(char *))) == NULL
+        || (paths = calloc(argc, sizeof(char *))) == NULL) {
+        free(run.args);
+        printf("\t[LCUT]: lcut-run out of memory!, errcode[%d]\n", ENOMEM);
+        return 1;
+    }
+
+    /* the paths are searched once the pattern is known */
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--")) {
+            for (i++; i < argc; i++) {
+                run.args[++nargs] = argv[i];
+            }
+        } else if ((v = option_value("--jobs", argc, argv, &i)) != NULL
+                   || (v = option_value("-j", argc, argv, &i)) != NULL) {
+            rv = parse_count(v, &(run.jobs));
+        } else if ((v = option_value("--timeout", argc, argv, &i)) != NULL) {
+            rv = parse_count(v, &(run.timeout_sec));
+        } else if ((v = option_value("--pattern", argc, argv, &i)) != NULL) {
+            run.pattern = v;
+        } else if (!strcmp(argv[i], "--quiet")) {
+            run.quiet = 1;
+        } else if (argv[i][0] == '-') {
+            rv = EINVAL;
+        } else {
+            paths[npaths++] = argv[i];
+        }
+        if (rv != 0) {
+            printf("\t[LCUT]: invalid option %s, errcode[%d]\n", argv[i], rv);
+            printf("usage: %s [-j N] [--pattern=GLOB] [--timeout=SEC] [--quiet] [PATH...] [-- ARGS...]\n",
+                   argv[0]);
+            free(paths);
+            run_destroy(&run);
+            return 1;
+        }
+    }
+    if (run.jobs == 0) {
+        run.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (run.jobs < 1) {
+            run.jobs = 1;
+        }
+    }
+
+    for (i = 0; rv == 0 && i < npaths; i++) {
+        if (stat(paths[i], &st) != 0) {
+            rv = errno;
+        } else if (S_ISDIR(st.st_mode)) {
+            rv = discover(&run, paths[i]);
+        } else {
+            rv = bin_add(&run, paths[i]);
+        }
+    }
+    if (rv == 0 && npaths == 0) {
+        rv = discover(&run, ".");
+    }
+    free(paths);
+    if (rv != 0) {
+        printf("\t[LCUT]: searching the test binaries failed!, errcode[%d]\n", rv);
+        run_destroy(&run);
+        return 1;
+    }
+    if (run.nbins == 0) {
+        printf("\t[LCUT]: no test binaries matching '%s' found, errcode[%d]\n", run.pattern, ENOENT);
+        run_destroy(&run);
+        return 1;
+    }
+    qsort(run.bins, run.nbins, sizeof(run.bins[0]), bin_cmp);
+    if (run.jobs > run.nbins) {
+        run.jobs = run.nbins;
+    }
+
+    begin = now_ns();
+    run_bins(&run);
+    rv = report(&run, now_ns() - begin);
+
+    run_destroy(&run);
+    return rv;
+}